@@ -61,12 +61,6 @@ Disclaimer:			This software is provided by the copyright holder "as is" and any
 // If you change this parameter adapt function fill_bulb().
 #define GRAINS_TOTAL		54
 
-// cycle times for dot-matrix display
-#define DM_PRESCALER		2			// prescaler = 1:8 (do not change)
-#define DM_REFRESH_FREQ		2500		// dot matrix column refresh rate (Hz)
-										// If you change this value adapt function wait().
-#define DM_REFRESH			(uint16_t)(0.5 + F_CPU / (8.0 * DM_REFRESH_FREQ))
-
 // simulation parameters
 #define SIM_SPEED			10			// default simulation speed
 #define CALIBRATION			1.0			// time calibration factor
@@ -101,6 +95,9 @@ Disclaimer:			This software is provided by the copyright holder "as is" and any
 #else
 #error "bad PWM_PRESCALER setting"
 #endif
+#if defined(DM_USE_USI) && ((PWM_PIN == PA4) || (PWM_PIN == PA5))
+#error "PA4 and PA5 are used by the USI, select another PWM_PIN"
+#endif
 #define	PWM_FREQ		(F_CPU / (PWM_PRESC_FACTOR * 510.0))
 #define PWM_OFF			0				// duty cycle =  0 %
 #define PWM_25			64				// duty cycle = 25 %
@@ -128,11 +125,6 @@ Disclaimer:			This software is provided by the copyright holder "as is" and any
 #define POLYNOMIAL		0b00001110		// feedback polynomial
 #define RANDOM_SEED		120
 
-// processor clock
-#ifndef F_CPU
-#define F_CPU	8000000		// 8 MHz
-#endif
-
 
 FUSES =
 {
@@ -178,13 +170,17 @@ uint8_t ee_time_setting[2] EEMEM = {0, 2};
 void init_hardware()
 {
 	// i/o ports
-	PORTA = 0x0F;					// use pull-ups on PA0..3
-	DDRA  = (1 << PWM_PIN);			// make PWM_PIN an output
+	PORTA |= 0x0F;					// use pull-ups on PA0..3
+	DDRA  |= (1 << PWM_PIN);		// make PWM_PIN an output
 
 	// use timer1 as system time base running at 1 MHz
 	OCR1A  = DM_REFRESH;			// set dot matrix refresh time
 	OCR1B  = 0;
+#ifdef DM_USE_USI
+	TCCR1A = 0;						// normal mode, OC1B (PA5 = USI DO) disconnected
+#else
 	TCCR1A = (PWM_MODE << COM1B0);	// normal mode
+#endif
 	TCCR1B = (DM_PRESCALER << CS10);
 	TIMSK1 = (1 << OCIE1A);
 
@@ -220,7 +216,13 @@ void wait(uint16_t ms)
 // Instead of all the floating point arithmetic we choose a faster implementation
 // which is only valid for DM_REFRESH_FREQ = 2500 Hz.
 	alarm = timer + (ms << 1) + (ms >> 1);	// = timer + 2.5 * ms
+#ifdef DM_COLUMN_RING
+	while (timer != alarm) {				// wait on alarm
+		DotMatrix::fillRing();				// meanwhile render the next columns
+	}
+#else
 	while (timer != alarm);					// wait on alarm
+#endif
 }
 
 
@@ -419,22 +421,22 @@ void display_time_setting(uint8_t m, uint8_t q, uint8_t gravity)
 
 	screen[0] = 0x01;			// select font1 (diagonal_ccw)
 //	screen[0] = 0x02;			// select font2 (diagonal_cw)
-	screen[1] = 0x10 | GREEN;
+	screen[1] = 0x10 | COLOR_CODE(GREEN);
 
 	if (gravity == DOWN) {
 		m += 48;
 		q += 58;
-		screen[1] = 0x10 | GREEN;
+		screen[1] = 0x10 | COLOR_CODE(GREEN);
 		screen[2] = m;
-		screen[3] = 0x10 | MEDIUMRED;
+		screen[3] = 0x10 | COLOR_CODE(MEDIUMRED);
 		screen[4] = q;
 	}
 	else {
 		m += 34;
 		q += 44;
-		screen[1] = 0x10 | MEDIUMRED;
+		screen[1] = 0x10 | COLOR_CODE(MEDIUMRED);
 		screen[2] = q;
-		screen[3] = 0x10 | GREEN;
+		screen[3] = 0x10 | COLOR_CODE(GREEN);
 		screen[4] = m;
 	}
 	screen[5] = 0;				// terminating zero
@@ -443,17 +445,12 @@ void display_time_setting(uint8_t m, uint8_t q, uint8_t gravity)
 
 uint8_t upper_bulb_empty()
 // Check if all grains of sand have left the upper bulb.
+// (orientation does not matter for the whole bulb, see get_pixel())
 {
-	uint8_t x, y;
+	uint8_t x = 0;
 
-	for (y = 0; y < 8; y++) {
-		for (x = 0; x < 8; x++) {
-			if (get_pixel(x, y, UPPER) != BLACK) {
-				return(0);
-			}
-		}
-	}
-	return(1);
+	if (UPPER ^ gravity) { x = 8; }
+	return( dm.readRegion(x, 0, 8, 8, VISIBLE, 0, 0, 0) == 0 );
 }
 
 
@@ -463,7 +460,7 @@ void alarm_signal()
 	wait(500);
 	dm.clearScreen();
 	screen[0] = 1;
-	screen[1] = 0x10 | ORANGE;
+	screen[1] = 0x10 | COLOR_CODE(ORANGE);
 	screen[2] = ' ';
 	screen[3] = ' ';
 	screen[4] = 0;
@@ -601,12 +598,19 @@ int main(void)
 
 ISR(TIM1_COMPA_vect)
 // dot matrix refresh interrupt
-// Called periodically at a rate defined by DM_REFRESH_FREQ.
+// Called periodically at an average rate defined by DM_REFRESH_FREQ.
 {
-	OCR1A += DM_REFRESH;				// setup next interrupt cycle
+#ifdef DM_PROFILING
+	uint16_t t_entry = TCNT1;			// time of entry
+	uint16_t t_due = OCR1A;				// time of compare match
+#endif
+	OCR1A += DotMatrix::slotLength();	// setup next interrupt cycle
 	timer++;
 	sei();
 	DotMatrix::update();
+#ifdef DM_PROFILING
+	DotMatrix::profile(t_due, t_entry);
+#endif
 }
 
 
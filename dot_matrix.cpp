@@ -32,11 +32,12 @@ Disclaimer:			This software is provided by the copyright holder "as is" and any
 #include <avr/io.h>
 #include <avr/pgmspace.h>
 #include <util/atomic.h>
-#include <util/delay.h>
 
 #include "dot_matrix.h"
 #include "fonts.h"
 
+#include <util/delay.h>				// after dot_matrix.h, which provides the F_CPU default
+
 #ifdef EEPROM
 #include <avr/eeprom.h>
 #endif
@@ -47,17 +48,80 @@ Disclaimer:			This software is provided by the copyright holder "as is" and any
  **************************/
 
 #ifdef ENABLE_HIDDEN_SCREEN
-pixcol_t	DotMatrix::screen[NUM_BLOCKS * COLS_PER_BLOCK * 2];
+scrcol_t	DotMatrix::screen[NUM_BLOCKS * COLS_PER_BLOCK * 2];
+#else
+scrcol_t	DotMatrix::screen[NUM_BLOCKS * COLS_PER_BLOCK];
+#endif
+#ifdef DM_PHASE_PLANES
+#ifdef ENABLE_HIDDEN_SCREEN
+uint16_t	DotMatrix::plane[3][NUM_BLOCKS * COLS_PER_BLOCK * 2];
 #else
-pixcol_t	DotMatrix::screen[NUM_BLOCKS * COLS_PER_BLOCK];
+uint16_t	DotMatrix::plane[3][NUM_BLOCKS * COLS_PER_BLOCK];
+#endif
 #endif
-pixcol_t*	DotMatrix::scr_vis;			// visible screen
-pixcol_t*	DotMatrix::scr_hid;			// hidden screen
-pixcol_t*	DotMatrix::scr_wrk;			// working screen
+scrcol_t*	DotMatrix::scr_vis;			// visible screen
+scrcol_t*	DotMatrix::scr_hid;			// hidden screen
+scrcol_t*	DotMatrix::scr_wrk;			// working screen
+scrcol_t*	DotMatrix::scr_out;			// screen which is being shifted out
+volatile uint8_t	DotMatrix::swap_req;	// swap of screens requested
+volatile uint8_t	DotMatrix::frame_cnt;	// frame counter
 uint8_t		DotMatrix::offset;			// screen offset
+#ifdef DM_VSCROLL
+uint8_t		DotMatrix::voffset;			// vertical screen offset
+#endif
+dm_colmap_t	DotMatrix::colmap[DM_COLMAPS];		// column tables: one in use, the other one is rebuilt
+dm_colmap_t*	DotMatrix::cmap;		// column table used by the refresh
+#ifdef DM_VIEWPORTS
+uint8_t		DotMatrix::vp_x[NUM_BLOCKS];	// screen position shown by each PixBlock
+uint8_t		DotMatrix::vp_y[NUM_BLOCKS];
+#endif
+#ifdef DM_ROTATION
+uint8_t		DotMatrix::orient;			// display orientation
+#endif
 uint8_t		DotMatrix::column;			// current column number
 uint8_t		DotMatrix::bright_cnt;		// current brightness level
+#ifdef DM_DIMMING
+uint8_t		DotMatrix::dim_on;			// 1 if a dark frame is appended to each brightness cycle
+uint16_t	DotMatrix::slot_len[DM_FRAMES + 1];	// slot of each frame (last one: dark frame)
+#endif
+#ifdef DM_MONO
+uint8_t		DotMatrix::mono_color;		// color of all pixels
+uint16_t	DotMatrix::mono_out[DM_FRAMES];	// output of mono_color in each frame
+#endif
+#ifdef DM_PALETTE
+uint8_t		DotMatrix::pal[4];			// palette colors
+uint16_t	DotMatrix::pal_out[DM_FRAMES][4];	// output of the palette entries in each frame
+#endif
 uint8_t		DotMatrix::color;			// current color
+#ifdef DM_PROFILING
+dm_profile_t	DotMatrix::prof;		// refresh interrupt statistics
+#endif
+#ifdef DM_COLUMN_RING
+dm_ringframe_t	DotMatrix::ring[DM_RING_SIZE];	// column frames rendered in advance
+volatile uint8_t	DotMatrix::ring_head;	// written by fillRing() only
+volatile uint8_t	DotMatrix::ring_tail;	// written by update() only
+volatile uint8_t	DotMatrix::ring_slot;	// number of the next interrupt
+volatile uint8_t	DotMatrix::ring_epoch;	// incremented on each underrun
+uint16_t	DotMatrix::ring_underruns;	// interrupts without a matching frame
+uint16_t	DotMatrix::ring_dropped;	// outdated frames skipped by update()
+uint8_t		DotMatrix::rp_slot;			// state of the producer (fillRing())
+uint8_t		DotMatrix::rp_epoch;
+uint8_t		DotMatrix::rp_column;
+uint8_t		DotMatrix::rp_bright;
+scrcol_t*	DotMatrix::rp_scr;
+#endif
+
+
+// output planes (one per brightness phase)
+#define PLANE_OR		0		// msb | lsb, shown in phase 0
+#define PLANE_AND		1		// msb & lsb, shown in phases 1 and 3
+#define PLANE_MSB		2		// msb,       shown in phase 2
+
+#define PIXCOL_WORDS	(sizeof(pixcol_t) / sizeof(uint16_t))	// number of bit planes in a pixel column
+
+#ifdef DM_DIMMING
+static const uint16_t dark_words[NUM_BLOCKS] = { 0 };	// shifted out during the dark frame
+#endif
 
 
 /********
@@ -68,6 +132,67 @@ const uint16_t PROGMEM pixcol_mask[8] = {
 	0x0001, 0x0004, 0x0010, 0x0040, 0x0100, 0x0400, 0x1000, 0x4000
 };
 
+#ifdef DM_SPREAD_LUT
+// spread the 8 pixels of a byte to the green bit positions of a pixel column
+// (bit i -> bit 2i, e. g. 11011111 -> 0101000101010101)
+const uint16_t PROGMEM pixel_spread[256] = {
+	0x0000, 0x0001, 0x0004, 0x0005, 0x0010, 0x0011, 0x0014, 0x0015,
+	0x0040, 0x0041, 0x0044, 0x0045, 0x0050, 0x0051, 0x0054, 0x0055,
+	0x0100, 0x0101, 0x0104, 0x0105, 0x0110, 0x0111, 0x0114, 0x0115,
+	0x0140, 0x0141, 0x0144, 0x0145, 0x0150, 0x0151, 0x0154, 0x0155,
+	0x0400, 0x0401, 0x0404, 0x0405, 0x0410, 0x0411, 0x0414, 0x0415,
+	0x0440, 0x0441, 0x0444, 0x0445, 0x0450, 0x0451, 0x0454, 0x0455,
+	0x0500, 0x0501, 0x0504, 0x0505, 0x0510, 0x0511, 0x0514, 0x0515,
+	0x0540, 0x0541, 0x0544, 0x0545, 0x0550, 0x0551, 0x0554, 0x0555,
+	0x1000, 0x1001, 0x1004, 0x1005, 0x1010, 0x1011, 0x1014, 0x1015,
+	0x1040, 0x1041, 0x1044, 0x1045, 0x1050, 0x1051, 0x1054, 0x1055,
+	0x1100, 0x1101, 0x1104, 0x1105, 0x1110, 0x1111, 0x1114, 0x1115,
+	0x1140, 0x1141, 0x1144, 0x1145, 0x1150, 0x1151, 0x1154, 0x1155,
+	0x1400, 0x1401, 0x1404, 0x1405, 0x1410, 0x1411, 0x1414, 0x1415,
+	0x1440, 0x1441, 0x1444, 0x1445, 0x1450, 0x1451, 0x1454, 0x1455,
+	0x1500, 0x1501, 0x1504, 0x1505, 0x1510, 0x1511, 0x1514, 0x1515,
+	0x1540, 0x1541, 0x1544, 0x1545, 0x1550, 0x1551, 0x1554, 0x1555,
+	0x4000, 0x4001, 0x4004, 0x4005, 0x4010, 0x4011, 0x4014, 0x4015,
+	0x4040, 0x4041, 0x4044, 0x4045, 0x4050, 0x4051, 0x4054, 0x4055,
+	0x4100, 0x4101, 0x4104, 0x4105, 0x4110, 0x4111, 0x4114, 0x4115,
+	0x4140, 0x4141, 0x4144, 0x4145, 0x4150, 0x4151, 0x4154, 0x4155,
+	0x4400, 0x4401, 0x4404, 0x4405, 0x4410, 0x4411, 0x4414, 0x4415,
+	0x4440, 0x4441, 0x4444, 0x4445, 0x4450, 0x4451, 0x4454, 0x4455,
+	0x4500, 0x4501, 0x4504, 0x4505, 0x4510, 0x4511, 0x4514, 0x4515,
+	0x4540, 0x4541, 0x4544, 0x4545, 0x4550, 0x4551, 0x4554, 0x4555,
+	0x5000, 0x5001, 0x5004, 0x5005, 0x5010, 0x5011, 0x5014, 0x5015,
+	0x5040, 0x5041, 0x5044, 0x5045, 0x5050, 0x5051, 0x5054, 0x5055,
+	0x5100, 0x5101, 0x5104, 0x5105, 0x5110, 0x5111, 0x5114, 0x5115,
+	0x5140, 0x5141, 0x5144, 0x5145, 0x5150, 0x5151, 0x5154, 0x5155,
+	0x5400, 0x5401, 0x5404, 0x5405, 0x5410, 0x5411, 0x5414, 0x5415,
+	0x5440, 0x5441, 0x5444, 0x5445, 0x5450, 0x5451, 0x5454, 0x5455,
+	0x5500, 0x5501, 0x5504, 0x5505, 0x5510, 0x5511, 0x5514, 0x5515,
+	0x5540, 0x5541, 0x5544, 0x5545, 0x5550, 0x5551, 0x5554, 0x5555
+};
+#endif
+
+#ifdef DM_ROTATION
+// reverse the order of the 4 pixels (bit pairs) of a byte
+const uint8_t PROGMEM pixel_reverse[256] = {
+	0x00, 0x40, 0x80, 0xC0, 0x10, 0x50, 0x90, 0xD0, 0x20, 0x60, 0xA0, 0xE0, 0x30, 0x70, 0xB0, 0xF0,
+	0x04, 0x44, 0x84, 0xC4, 0x14, 0x54, 0x94, 0xD4, 0x24, 0x64, 0xA4, 0xE4, 0x34, 0x74, 0xB4, 0xF4,
+	0x08, 0x48, 0x88, 0xC8, 0x18, 0x58, 0x98, 0xD8, 0x28, 0x68, 0xA8, 0xE8, 0x38, 0x78, 0xB8, 0xF8,
+	0x0C, 0x4C, 0x8C, 0xCC, 0x1C, 0x5C, 0x9C, 0xDC, 0x2C, 0x6C, 0xAC, 0xEC, 0x3C, 0x7C, 0xBC, 0xFC,
+	0x01, 0x41, 0x81, 0xC1, 0x11, 0x51, 0x91, 0xD1, 0x21, 0x61, 0xA1, 0xE1, 0x31, 0x71, 0xB1, 0xF1,
+	0x05, 0x45, 0x85, 0xC5, 0x15, 0x55, 0x95, 0xD5, 0x25, 0x65, 0xA5, 0xE5, 0x35, 0x75, 0xB5, 0xF5,
+	0x09, 0x49, 0x89, 0xC9, 0x19, 0x59, 0x99, 0xD9, 0x29, 0x69, 0xA9, 0xE9, 0x39, 0x79, 0xB9, 0xF9,
+	0x0D, 0x4D, 0x8D, 0xCD, 0x1D, 0x5D, 0x9D, 0xDD, 0x2D, 0x6D, 0xAD, 0xED, 0x3D, 0x7D, 0xBD, 0xFD,
+	0x02, 0x42, 0x82, 0xC2, 0x12, 0x52, 0x92, 0xD2, 0x22, 0x62, 0xA2, 0xE2, 0x32, 0x72, 0xB2, 0xF2,
+	0x06, 0x46, 0x86, 0xC6, 0x16, 0x56, 0x96, 0xD6, 0x26, 0x66, 0xA6, 0xE6, 0x36, 0x76, 0xB6, 0xF6,
+	0x0A, 0x4A, 0x8A, 0xCA, 0x1A, 0x5A, 0x9A, 0xDA, 0x2A, 0x6A, 0xAA, 0xEA, 0x3A, 0x7A, 0xBA, 0xFA,
+	0x0E, 0x4E, 0x8E, 0xCE, 0x1E, 0x5E, 0x9E, 0xDE, 0x2E, 0x6E, 0xAE, 0xEE, 0x3E, 0x7E, 0xBE, 0xFE,
+	0x03, 0x43, 0x83, 0xC3, 0x13, 0x53, 0x93, 0xD3, 0x23, 0x63, 0xA3, 0xE3, 0x33, 0x73, 0xB3, 0xF3,
+	0x07, 0x47, 0x87, 0xC7, 0x17, 0x57, 0x97, 0xD7, 0x27, 0x67, 0xA7, 0xE7, 0x37, 0x77, 0xB7, 0xF7,
+	0x0B, 0x4B, 0x8B, 0xCB, 0x1B, 0x5B, 0x9B, 0xDB, 0x2B, 0x6B, 0xAB, 0xEB, 0x3B, 0x7B, 0xBB, 0xFB,
+	0x0F, 0x4F, 0x8F, 0xCF, 0x1F, 0x5F, 0x9F, 0xDF, 0x2F, 0x6F, 0xAF, 0xEF, 0x3F, 0x7F, 0xBF, 0xFF
+};
+#endif
+
 const char PROGMEM logo_string[] = ("\n\x01\x1C" "Pix" "\x17" "Block" "\x13" "fab" "\x1F" "4" "\x13" "U ");
 
 
@@ -75,6 +200,20 @@ const char PROGMEM logo_string[] = ("\n\x01\x1C" "Pix" "\x17" "Block" "\x13" "fa
  * methods *
  ***********/
 
+uint8_t DotMatrix::expandColor(const uint8_t code)
+// Convert a 4 bit color code (4 intensity levels per led) to a color
+// of the current color depth.
+{
+#if DM_COLOR_DEPTH > 2
+	static const uint8_t PROGMEM level[4] = { 0, LEVEL_25, LEVEL_50, LEVEL_100 };
+
+	return( RG_COLOR(pgm_read_byte(&level[(code >> 2) & 3]), pgm_read_byte(&level[code & 3])) );
+#else
+	return(code);
+#endif
+}
+
+
 void DotMatrix::displayLogo()
 {
 	if (NUM_BLOCKS_Y == 1) {
@@ -112,6 +251,9 @@ void DotMatrix::init()
 	DM_DATA_DDR   |=  (1 << DM_DATA_BIT);
 	DM_CLK_DDR    |=  (1 << DM_CLK_BIT);
 	DM_LATCH_DDR  |=  (1 << DM_LATCH_BIT);
+#ifdef DM_USE_USI
+	USICR = (1 << USIWM0);			// three-wire mode, DO and USCK driven by the USI
+#endif
 
 #ifdef ENABLE_HIDDEN_SCREEN
 	// with hidden screen
@@ -124,11 +266,46 @@ void DotMatrix::init()
 #endif
 
 	scr_vis = &screen[0];
+	scr_out = scr_vis;
+	swap_req = 0;
 	selectScreen(VISIBLE);
 	clearScreen();
 	column = 0;
+#ifdef DM_VIEWPORTS
+	for (uint8_t k = 0; k < NUM_BLOCKS; k++) {	// each PixBlock shows its own position
+		vp_x[k] = (k % NUM_BLOCKS_X) * COLS_PER_BLOCK;
+		vp_y[k] = (k / NUM_BLOCKS_X) * ROWS_PER_BLOCK;
+	}
+#endif
+	calcColIdx();
+#ifdef DM_BCM
+	bright_cnt = 0;						// start with lsb plane
+#else
 	bright_cnt = MAX_BRIGHTNESS;
+#endif
+#ifdef DM_DIMMING
+	setBrightness(DM_DIM_STEPS);
+#endif
+#ifdef DM_MONO
+	setMonoColor(DEFAULT_COLOR);
+#endif
+#ifdef DM_PALETTE
+	setPalette(0, BLACK);
+	setPalette(1, GREEN);
+	setPalette(2, RED);
+	setPalette(3, ORANGE);
+#endif
 	color = DEFAULT_COLOR;
+#ifdef DM_PROFILING
+	clearProfile();
+#endif
+#ifdef DM_COLUMN_RING
+	ring_head = ring_tail = 0;
+	ring_slot = 0;
+	ring_epoch = 0;
+	rp_epoch = ring_epoch - 1;			// producer starts with a resync
+	ring_underruns = ring_dropped = 0;
+#endif
 }
 
 
@@ -136,69 +313,662 @@ void DotMatrix::setOffset(const uint8_t col)
 // set the screen offset (range 0..NUM_PIXCOLS-1)
 // The offset value determines which column of the screen is displayed
 // in the leftmost column of the (leftmost) PixBlock.
+// The offset is added during refresh, so changing it costs O(1).
 {
 	if (col < NUM_PIXCOLS) {
-		ATOMIC_BLOCK(ATOMIC_FORCEON) {
-			offset = col;
+		offset = col;
+	}
+}
+
+
+#ifdef DM_VSCROLL
+
+void DotMatrix::setVOffset(const uint8_t row)
+// set the vertical screen offset (range 0..DIM_Y-1)
+// The offset value determines which row of the screen is displayed
+// in the top row of the (top) PixBlock. Rows wrap around from the
+// bottom to the top of the screen.
+{
+	if (row < DIM_Y) {
+		voffset = row;
+		calcColIdx();
+	}
+}
+
+#endif
+
+
+#ifdef DM_VIEWPORTS
+
+void DotMatrix::setViewport(const uint8_t block, const uint8_t x, const uint8_t y)
+// Select the region of the screen shown by a PixBlock.
+// PixBlocks are numbered from left to right and top to bottom. The PixBlock
+// shows the screen from column x and row y on (wrapping around at the
+// right and bottom edge). Offsets set by setOffset() and setVOffset() are
+// added on top. Without DM_VSCROLL y is rounded down to a whole PixBlock.
+{
+	if ((block < NUM_BLOCKS) && (x < DIM_X) && (y < DIM_Y)) {
+		vp_x[block] = x;
+		vp_y[block] = y;
+		calcColIdx();
+	}
+}
+
+#endif
+
+
+#ifdef DM_ROTATION
+
+void DotMatrix::setOrientation(uint8_t orientation)
+// Turn the display (DM_ROT_0, DM_ROT_90, DM_ROT_180 or DM_ROT_270).
+// The screen contents are not changed, they are only shown turned.
+// DM_ROT_180 is applied while shifting out. DM_ROT_90 turns each PixBlock
+// in place by rebuilding the output planes, so it requires DM_PHASE_PLANES
+// (otherwise it is ignored).
+{
+#ifdef DM_PHASE_PLANES
+	uint8_t	old = orient;
+	uint8_t	i, c;
+
+	orientation &= DM_ROT_270;
+#else
+	orientation &= DM_ROT_180;
+#endif
+	orient = orientation;
+	calcColIdx();
+#ifdef DM_PHASE_PLANES
+	if ((old ^ orientation) & DM_ROT_90) {	// rebuild output planes of all screens
+		for (i = 0; i < (sizeof(screen) / sizeof(screen[0])); i += COLS_PER_BLOCK) {
+			if (orientation & DM_ROT_90) {
+				renderRot90(screen, i);
+			}
+			else {
+				for (c = i; c < i + COLS_PER_BLOCK; c++) {
+					plane[PLANE_OR][c]  = screen[c].msb | screen[c].lsb;
+					plane[PLANE_AND][c] = screen[c].msb & screen[c].lsb;
+					plane[PLANE_MSB][c] = screen[c].msb;
+				}
+			}
 		}
 	}
+#endif
 }
 
+#endif
+
+
+#ifdef DM_DIMMING
+
+void DotMatrix::setBrightness(uint8_t level)
+// Set the brightness of the whole display (1..DM_DIM_STEPS, DM_DIM_STEPS = full).
+// A dark frame is appended to each brightness cycle and the slots of the
+// other frames are shortened accordingly. The average slot length (and
+// therefore the rate of the refresh interrupt) is not changed. No slot is
+// made shorter than DM_DIM_SLOT_MIN, which limits the lowest levels.
+{
+	uint16_t	slot[DM_FRAMES + 1];
+	uint16_t	total, lit, sum;
+	uint8_t		f;
+
+	if (level < 1) { level = 1; }
+	if (level > DM_DIM_STEPS) { level = DM_DIM_STEPS; }
+
+	total = DM_FRAMES * DM_REFRESH;		// time of all lit frames per column
+	slot[DM_FRAMES] = 0;
+	if (level < DM_DIM_STEPS) {
+		total += DM_REFRESH;			// plus dark frame
+		slot[DM_FRAMES] = (uint32_t)total * (DM_DIM_STEPS - level) / DM_DIM_STEPS;
+		if (slot[DM_FRAMES] < DM_DIM_SLOT_MIN) { slot[DM_FRAMES] = DM_DIM_SLOT_MIN; }
+	}
+	lit = total - slot[DM_FRAMES];
+	sum = 0;
+	for (f = 0; f < DM_FRAMES; f++) {
+#ifdef DM_BCM
+		slot[f] = (f == DM_COLOR_DEPTH - 1) ? DM_REFRESH_MSB : (DM_REFRESH_LSB << f);
+#else
+		slot[f] = DM_REFRESH;
+#endif
+
+		slot[f] = (uint32_t)slot[f] * lit / (DM_FRAMES * DM_REFRESH);
+		if (slot[f] < DM_DIM_SLOT_MIN) { slot[f] = DM_DIM_SLOT_MIN; }
+		sum += slot[f];
+	}
+	if (sum <= lit)	{ slot[DM_LAST_FRAME] += lit - sum; }	// remainder to the longest frame
+	else			{ slot[DM_FRAMES] -= sum - lit; }		// (limited slots) taken from the dark frame
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		for (f = 0; f <= DM_FRAMES; f++) { slot_len[f] = slot[f]; }
+		dim_on = (level < DM_DIM_STEPS);
+#ifdef DM_COLUMN_RING
+		ring_epoch++;					// frames in the ring follow the old sequence
+#endif
+	}
+}
+
+#endif
+
+
+uint16_t DotMatrix::frameWord(const pixcol_t* pc, const uint8_t f)
+// return the output of pixel column pc in brightness phase / bit plane f
+{
+#ifdef DM_BCM
+	return ((&pc->lsb)[f]);
+#else
+	if (f & 1)		{ return (pc->msb & pc->lsb); }	// see column_word()
+	if (f == 2)		{ return (pc->msb); }
+	return (pc->msb | pc->lsb);
+#endif
+}
+
+
+#ifdef DM_MONO
+
+void DotMatrix::setMonoColor(const uint8_t color)
+// Set the color of all pixels that are on.
+{
+	pixcol_t	pc;
+	uint8_t		f;
+
+	mono_color = color;
+	pattern2PixCol(0xFF, color, &pc);
+	for (f = 0; f < DM_FRAMES; f++) {
+		ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+			mono_out[f] = frameWord(&pc, f);
+		}
+	}
+}
+
+#endif
+
+
+#ifdef DM_PALETTE
+
+void DotMatrix::setPalette(const uint8_t index, const uint8_t color)
+// Set palette entry index (0..3) to color.
+// All pixels drawn with DM_PAL(index) change their color with the next frame.
+// The output of each entry in each frame is precomputed here; pal_out holds
+// entry 0, entry 0 ^ entry 1, entry 2 and entry 2 ^ entry 3 for column_word().
+{
+	pixcol_t	pc[4];
+	uint16_t	w[4];
+	uint8_t		f, i;
+
+	pal[index & 3] = color;
+	for (i = 0; i < 4; i++) { pattern2PixCol(0xFF, pal[i], &pc[i]); }
+	for (f = 0; f < DM_FRAMES; f++) {
+		for (i = 0; i < 4; i++) { w[i] = frameWord(&pc[i], f); }
+		ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+			pal_out[f][0] = w[0];
+			pal_out[f][1] = w[0] ^ w[1];
+			pal_out[f][2] = w[2];
+			pal_out[f][3] = w[2] ^ w[3];
+		}
+	}
+}
+
+#endif
+
+
+void DotMatrix::calcColIdx()
+// Calculate the pixel column which is shifted out for each column and
+// PixBlock at offset 0 (last PixBlock first). update() adds the screen
+// offset, so the table only changes with the layout.
+// With DM_VSCROLL the table starts at the block row given by the vertical
+// offset and is followed by the same table for the block row below.
+// If the layout can change at runtime the table is built in the spare column
+// map outside of a critical section, only the switch of the map pointer
+// blocks the refresh interrupt.
+{
+	uint8_t		col, cc, b, k, x, y;
+	uint16_t	c;
+	dm_colmap_t*	m = (cmap == &colmap[0]) ? &colmap[DM_COLMAPS - 1] : &colmap[0];
+	uint8_t*	ci = m->idx;
+
+	for (col = 0; col < COLS_PER_BLOCK; col++) {
+		for (b = 0; b < NUM_BLOCKS; b++) {
+			k = NUM_BLOCKS - 1 - b;				// PixBlock (last one is shifted out first)
+			cc = col;
+#ifdef DM_REVERSE_COLS
+			cc = (COLS_PER_BLOCK - 1) - cc;
+#endif
+#ifdef DM_ROTATION
+			if (orient & DM_ROT_180) {			// show the opposite PixBlock with reversed columns
+				k = b;
+				cc = (COLS_PER_BLOCK - 1) - cc;
+			}
+#endif
+#ifdef DM_VIEWPORTS
+			x = vp_x[k];
+			y = vp_y[k];
+#else
+			x = (k % NUM_BLOCKS_X) * COLS_PER_BLOCK;
+			y = (k / NUM_BLOCKS_X) * ROWS_PER_BLOCK;
+#endif
+			x = (x + cc) % DIM_X;
+#ifdef DM_VSCROLL
+			y = (y + voffset) % DIM_Y;
+			m->vshift[b] = (y & (ROWS_PER_BLOCK - 1)) * 2;	// 2 bits per row
+#endif
+			c = (y / ROWS_PER_BLOCK) * DIM_X + x;
+#ifdef DM_VSCROLL
+			ci[NUM_PIXCOLS] = (c + DIM_X) % NUM_PIXCOLS;	// block row below
+#endif
+			*ci++ = c % NUM_PIXCOLS;
+		}
+	}
+#ifdef DM_ROTATION
+	m->rev = (orient & DM_ROT_180) ? 1 : 0;
+#endif
+	ATOMIC_BLOCK(ATOMIC_FORCEON) {
+		cmap = m;
+	}
+}
+
+
+#ifdef DM_USE_USI
+
+// USI control values for three-wire mode with software clock strobe
+#define USI_TICK		((1 << USIWM0) | (1 << USITC))					// toggle USCK
+#define USI_TICK_SHIFT	((1 << USIWM0) | (1 << USITC) | (1 << USICLK))	// toggle USCK and shift
+
+static inline void usi_shift_byte(const uint8_t data)
+// Shift out one byte (MSB first) with the USI.
+// The clock line is left high after the last rising edge, exactly like
+// the bit-banged version does.
+{
+	USIDR = data;						// DO = bit 7
+	DM_CLK_PORT &= ~(1 << DM_CLK_BIT);	// clock low
+	USICR = USI_TICK;					// rising edge -> bit 7
+	USICR = USI_TICK_SHIFT;				// falling edge, DO = bit 6
+	USICR = USI_TICK;					// rising edge -> bit 6
+	USICR = USI_TICK_SHIFT;
+	USICR = USI_TICK;					// bit 5
+	USICR = USI_TICK_SHIFT;
+	USICR = USI_TICK;					// bit 4
+	USICR = USI_TICK_SHIFT;
+	USICR = USI_TICK;					// bit 3
+	USICR = USI_TICK_SHIFT;
+	USICR = USI_TICK;					// bit 2
+	USICR = USI_TICK_SHIFT;
+	USICR = USI_TICK;					// bit 1
+	USICR = USI_TICK_SHIFT;
+	USICR = USI_TICK;					// bit 0
+}
+
+#else
+
+template <uint8_t N>
+static inline __attribute__((always_inline)) void shift_bits(uint16_t t)
+// Shift out N bits of the toggle mask t (unrolled at compile time).
+// A set bit toggles the data pin, so each bit takes the same time.
+{
+#ifdef DM_LSB_FIRST
+	DM_DATA_PIN = ((uint8_t)t & 1) << DM_DATA_BIT;
+	t >>= 1;
+#else
+	DM_DATA_PIN = ((uint8_t)(t >> 8) >> 7) << DM_DATA_BIT;
+	t <<= 1;
+#endif
+	// clock, rising egde
+	DM_CLK_PORT &= ~(1 << DM_CLK_BIT);
+	DM_CLK_PORT |=  (1 << DM_CLK_BIT);
+	shift_bits<N - 1>(t);
+}
+
+template <>
+inline void shift_bits<0>(uint16_t t) {}
+
+#endif
+
 
 void DotMatrix::shift_out(uint16_t data)
 // shift out the data
 {
-	for (uint8_t i = 0; i < 16; i++) {
+#ifdef DM_USE_USI
+	usi_shift_byte(data >> 8);
+	usi_shift_byte(data);
+#else
+	uint16_t	t;
+	uint8_t		cur = (DM_DATA_PORT >> DM_DATA_BIT) & 1;	// current state of data pin
+
+	// toggle mask: bit is set where the data pin has to change
 #ifdef DM_LSB_FIRST
-		if (data & 0x0001) { DM_DATA_PORT |= (1 << DM_DATA_BIT); }
-		else { DM_DATA_PORT &= ~(1 << DM_DATA_BIT); }
-		data >>= 1;
+	t = data ^ ((data << 1) | cur);
 #else
-		if (data & 0x8000) { DM_DATA_PORT |= (1 << DM_DATA_BIT); }
-		else { DM_DATA_PORT &= ~(1 << DM_DATA_BIT); }
-		data <<= 1;
+	t = data ^ ((data >> 1) | ((uint16_t)cur << 15));
 #endif
-		// clock, rising egde
-		DM_CLK_PORT &= ~(1 << DM_CLK_BIT);
-		DM_CLK_PORT |=  (1 << DM_CLK_BIT);
+	shift_bits<16>(t);
+#endif
+}
+
+
+static inline uint16_t spread_bits(const uint8_t data)
+// spread data, i. e. insert a 0 to the left of every bit
+{
+#ifdef DM_SPREAD_LUT
+	return (pgm_read_word(&pixel_spread[data]));
+#else
+	uint16_t	t = data;
+
+	t = (t | (t << 4)) & 0x0F0F;
+	t = (t | (t << 2)) & 0x3333;
+	t = (t | (t << 1)) & 0x5555;
+	return (t);
+#endif
+}
+
+
+static inline uint8_t pack_bits(uint16_t data)
+// inverse of spread_bits(): gather the even bits of data
+{
+	data &= 0x5555;
+	data = (data | (data >> 1)) & 0x3333;
+	data = (data | (data >> 2)) & 0x0F0F;
+	data = (data | (data >> 4)) & 0x00FF;
+	return (data);
+}
+
+
+inline const uint16_t* DotMatrix::outputPlane(const scrcol_t* scr, const uint8_t bc)
+// return the data to be shifted out of screen scr in brightness phase / bit plane bc
+{
+#if defined(DM_PALETTE) || defined(DM_MONO)
+	return (0);							// column_word() reads scr_out
+#elif defined(DM_BCM)
+	return (&scr[0].lsb + bc);
+#elif defined(DM_PHASE_PLANES)
+	uint8_t	b;
+
+	if (bc & 1)			{ b = PLANE_AND; }	// bright_cnt == 1 or 3
+	else if (bc == 2)	{ b = PLANE_MSB; }
+	else				{ b = PLANE_OR; }
+	return (&plane[b][scr - screen]);
+#else
+	return (0);							// column_word() reads scr_out
+#endif
+}
+
+
+inline uint16_t DotMatrix::column_word(const uint16_t* pl, const uint8_t c)
+// return the data of pixel column c for the current brightness phase / bit plane
+{
+#if defined(DM_MONO)
+	uint16_t	w = spread_bits(scr_out[c]);
+
+	return ((w | (w << 1)) & mono_out[bright_cnt]);
+#elif defined(DM_PALETTE)
+	const uint16_t*	m = pal_out[bright_cnt];
+	uint16_t	w, a, b, lo, hi;
+
+	w = scr_out[c].lsb;					// palette indices
+	a = w & 0x5555;						// index bit 0 on both leds
+	a |= a << 1;
+	b = (w >> 1) & 0x5555;				// index bit 1 on both leds
+	b |= b << 1;
+	lo = m[0] ^ (m[1] & a);				// entry 0 or 1
+	hi = m[2] ^ (m[3] & a);				// entry 2 or 3
+	return (lo ^ ((lo ^ hi) & b));
+#elif defined(DM_BCM)
+	return (pl[c * PIXCOL_WORDS]);
+#elif defined(DM_PHASE_PLANES)
+	return (pl[c]);
+#else
+	uint16_t	br_msb, br_lsb;
+
+	br_msb = scr_out[c].msb;
+	br_lsb = scr_out[c].lsb;
+	if (bright_cnt & 1) { br_msb = br_msb & br_lsb; }	// bright_cnt == 1 or 3
+	//else if (bright_cnt == 2) { do nothing }
+	else if (bright_cnt == 0) { br_msb = br_msb | br_lsb; }
+	return (br_msb);
+#endif
+}
+
+
+static inline uint8_t wrap_col(const uint16_t c)
+// reduce a pixel column index (< 2 * NUM_PIXCOLS) to 0..NUM_PIXCOLS-1
+{
+#if (NUM_PIXCOLS & (NUM_PIXCOLS - 1)) == 0
+	return (c & (NUM_PIXCOLS - 1));
+#else
+	return ((c >= NUM_PIXCOLS) ? (c - NUM_PIXCOLS) : c);
+#endif
+}
+
+
+inline uint16_t DotMatrix::block_word(const uint16_t* pl, const uint8_t* ci, const uint8_t b)
+// return the data of PixBlock b (shift order) whose pixel column is given by ci (at offset 0)
+{
+#ifdef DM_VSCROLL
+	uint16_t	w;
+	uint8_t		vs = cmap->vshift[b];
+
+	w = column_word(pl, wrap_col(ci[0] + offset));
+	if (vs) {							// rotate in the rows of the block row below
+		w = (w >> vs) | (column_word(pl, wrap_col(ci[NUM_PIXCOLS] + offset)) << (16 - vs));
+	}
+#else
+	uint16_t	w = column_word(pl, wrap_col(*ci + offset));
+#endif
+#ifdef DM_ROTATION
+	if (cmap->rev) {					// reverse the order of the rows
+		w = (pgm_read_byte(&pixel_reverse[w & 0xFF]) << 8) | pgm_read_byte(&pixel_reverse[w >> 8]);
+	}
+#endif
+	return (w);
+}
+
+
+inline uint8_t DotMatrix::nextFrame(uint8_t bc)
+// return the brightness phase / bit plane of the frame following bc
+{
+#ifdef DM_DIMMING
+	if ((bc == DM_LAST_FRAME) && dim_on) { return (DM_FRAMES); }	// dark frame
+#endif
+#ifdef DM_BCM
+	bc++;								// next frame shows the next bit plane
+	if (bc >= DM_FRAMES) { bc = 0; }
+#else
+	bc--;
+	bc &= MAX_BRIGHTNESS;				// limit range
+#endif
+	return (bc);
+}
+
+
+template <>
+inline void DotMatrix::shift_blocks<0>(const uint16_t* pl, const uint8_t* ci) {}
+
+template <uint8_t N>
+inline void DotMatrix::shift_blocks(const uint16_t* pl, const uint8_t* ci)
+// shift out one column of N PixBlocks (unrolled at compile time)
+{
+	shift_out(block_word(pl, ci, NUM_BLOCKS - N));
+	shift_blocks<N - 1>(pl, ci + 1);
+}
+
+
+template <>
+inline void DotMatrix::shift_words<0>(const uint16_t* w) {}
+
+template <uint8_t N>
+inline void DotMatrix::shift_words(const uint16_t* w)
+// shift out N prepared column words (unrolled at compile time)
+{
+	shift_out(*w);
+	shift_words<N - 1>(w + 1);
+}
+
+
+#ifdef DM_COLUMN_RING
+
+inline const dm_ringframe_t* DotMatrix::popRing()
+// Return the frame for the current interrupt (or 0 if there is none).
+// Outdated frames are skipped. The frame is released before it is shifted
+// out, which is safe because fillRing() cannot run before update() returns.
+{
+	const dm_ringframe_t*	fr;
+	uint8_t					t = ring_tail;
+
+	while (t != ring_head) {
+		fr = &ring[t & (DM_RING_SIZE - 1)];
+		t++;
+		if ((fr->slot == ring_slot) && (fr->epoch == ring_epoch)) {
+			ring_tail = t;
+			return (fr);
+		}
+		if (ring_dropped < 0xFFFF) { ring_dropped++; }
 	}
+	ring_tail = t;
+	return (0);
 }
 
+
+void DotMatrix::fillRing()
+// Render the column frames of the next interrupts into the ring until it is full.
+// Should be called frequently from the main loop. Whenever the ring runs dry
+// update() renders the column itself and fillRing() starts over at the
+// current position of update().
+{
+	dm_ringframe_t*	fr;
+	const uint16_t*	pl;
+	const uint8_t*	ci;
+	uint8_t			h, b;
+
+	if (rp_epoch != ring_epoch) {		// ring has run dry -> resync
+		ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+			rp_epoch  = ring_epoch;
+			rp_slot   = ring_slot;
+			rp_column = column;
+			rp_bright = bright_cnt;
+			rp_scr    = scr_out;
+		}
+	}
+
+	h = ring_head;
+	while ((uint8_t)(h - ring_tail) < DM_RING_SIZE) {
+		// same sequence as in update()
+		if (rp_column == 0) {			// start of frame
+#ifdef DM_BCM
+			if (swap_req && (rp_bright == 0)) { rp_scr = scr_vis; }
+#else
+			if (swap_req) { rp_scr = scr_vis; }
+#endif
+		}
+		fr = &ring[h & (DM_RING_SIZE - 1)];
+		fr->slot  = rp_slot;
+		fr->epoch = rp_epoch;
+		fr->scr   = rp_scr;
+		pl = outputPlane(rp_scr, rp_bright);
+		ci = &cmap->idx[rp_column * NUM_BLOCKS];
+		for (b = 0; b < NUM_BLOCKS; b++) {
+#ifdef DM_DIMMING
+			if (rp_bright == DM_FRAMES) { fr->word[b] = 0; continue; }	// dark frame
+#endif
+			fr->word[b] = block_word(pl, &ci[b], b);
+		}
+		__asm__ __volatile__ ("" ::: "memory");	// frame complete before it is published
+		ring_head = ++h;
+
+		rp_slot++;
+		rp_column++;
+		rp_column &= COLS_PER_BLOCK - 1;
+		if (rp_column == 0) { rp_bright = nextFrame(rp_bright); }
+	}
+}
+
+
+uint16_t DotMatrix::getRingUnderruns()
+// number of interrupts that had to render their column themselves
+{
+	uint16_t n;
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		n = ring_underruns;
+	}
+	return (n);
+}
+
+
+uint16_t DotMatrix::getRingDropped()
+// number of outdated frames skipped by update()
+{
+	uint16_t n;
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		n = ring_dropped;
+	}
+	return (n);
+}
+
+#endif
+
+
 void DotMatrix::update()
 // Update one column on all PixBlock displays.
 // Should be called periodically.
+//
+// With DM_PHASE_PLANES the data of each block is a plain table fetch.
+// Estimated cost per PixBlock (avr-gcc -Os, without shift_out):
+//   phases computed here:  index 6 + load msb/lsb 8 + phase test 3..7 + and/or 0..2 = 17..23 cycles
+//   precomputed planes:    index 6 + load word 4                                     = 10 cycles
+// For the default chain of 2 blocks the worst case drops by about 26 cycles
+// per interrupt, for 8 blocks by about 100 cycles.
+//
+// The pixel column of each block is read from the column map and the screen
+// offset is added with a mask (or one compare if NUM_PIXCOLS is not a power
+// of 2), so setOffset() needs no rebuild. The block loop is unrolled.
+//
+// With DM_BCM the bit planes are shown one after the other for one frame each,
+// each plane with twice the column time of the previous one (see slotLength()).
+// With 2 bit planes a full brightness cycle takes 2 frames = 16 interrupts
+// instead of 4 frames = 32 interrupts.
 {
-	pixcol_t*	scr;
-	uint16_t	br_msb, br_lsb;
-	uint8_t		b;
-	uint8_t		c;			// index of pixel column which is to be shifted out
+#ifdef DM_COLUMN_RING
+	const dm_ringframe_t*	fr;
+#endif
 
-	if (column == 0) {
-		bright_cnt--;
-		bright_cnt &= MAX_BRIGHTNESS;	// limit range
+	if (column == 0) {					// start of frame
+		frame_cnt++;
 	}
 
-	// start with last (rightmost) PixBlock which has to be shifted out first
-	c = NUM_PIXCOLS - COLS_PER_BLOCK;
-	c +=  offset;								// add offset
-	if (c >= NUM_PIXCOLS) { c -= NUM_PIXCOLS; }	// on overflow -> wrap around
-#ifdef DM_REVERSE_COLS
-	c += (COLS_PER_BLOCK-1) - column;
+#ifdef DM_COLUMN_RING
+	fr = popRing();
+	if (fr) {							// frame has been rendered by fillRing()
+		if (fr->scr != scr_out) {		// screen swap (only at the start of a frame)
+			scr_out = fr->scr;
+			if (scr_out == scr_vis) { swap_req = 0; }
+		}
+		shift_words<NUM_BLOCKS>(fr->word);
+	}
+	else {								// ring has run dry -> render directly
+		if (ring_underruns < 0xFFFF) { ring_underruns++; }
+		ring_epoch++;
+#endif
+		if (column == 0) {
+#ifdef DM_BCM
+			if (swap_req && (bright_cnt == 0)) {	// do not mix bit planes of both screens
 #else
-	c += column;
+			if (swap_req) {
 #endif
-	for (b = 0; b < NUM_BLOCKS; b++) {
-		scr = &(scr_vis[c]);
-		br_msb = scr->msb;
-		br_lsb = scr->lsb;
-		c -= COLS_PER_BLOCK;
-		if (c >= NUM_PIXCOLS) { c += NUM_PIXCOLS; }	// on underflow -> wrap around
-		if (bright_cnt & 1) { br_msb = br_msb & br_lsb; }	// bright_cnt == 1 or 3
-		//else if (bright_cnt == 2) { do nothing }
-		else if (bright_cnt == 0) { br_msb = br_msb | br_lsb; }
-
-		shift_out(br_msb);
+				scr_out = scr_vis;		// show new visible screen
+				swap_req = 0;
+			}
+		}
+#ifdef DM_DIMMING
+		if (bright_cnt == DM_FRAMES) {	// dark frame
+			shift_words<NUM_BLOCKS>(dark_words);
+		}
+		else
+#endif
+		{
+			// start with last (rightmost) PixBlock which has to be shifted out first
+			shift_blocks<NUM_BLOCKS>(outputPlane(scr_out, bright_cnt), &cmap->idx[column * NUM_BLOCKS]);
+		}
+#ifdef DM_COLUMN_RING
 	}
+	ring_slot++;
+#endif
 
 	// set final state of clock pin
 	// used for column sync (low -> display column 0)
@@ -214,17 +984,270 @@ void DotMatrix::update()
 	// next column
 	column++;
 	column &= COLS_PER_BLOCK - 1;		// limit column range
+	if (column == 0) { bright_cnt = nextFrame(bright_cnt); }
+}
+
+
+#ifdef DM_PROFILING
+
+void DotMatrix::profile(const uint16_t t_due, const uint16_t t_entry)
+// Record latency and duration of the refresh interrupt.
+// Has to be called at the end of the refresh interrupt with the compare
+// value (OCR1A) and the timer value (TCNT1) sampled on entry.
+{
+	uint16_t	now, lat, dur;
+	uint8_t		bin;
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		now = TCNT1;
+		lat = t_entry - t_due;
+		dur = now - t_entry;
+		if ((uint16_t)(now - t_due) >= (uint16_t)(OCR1A - t_due)) {	// next compare match has passed
+			if (prof.missed < 0xFFFF) { prof.missed++; }
+		}
+		prof.samples++;
+		prof.dur_sum += dur;
+		if (dur < prof.dur_min) { prof.dur_min = dur; }
+		if (dur > prof.dur_max) { prof.dur_max = dur; }
+		if (lat < prof.lat_min) { prof.lat_min = lat; }
+		if (lat > prof.lat_max) { prof.lat_max = lat; }
+		bin = DM_PROF_BINS - 1;
+		if ((dur >> DM_PROF_BIN_SHIFT) < (DM_PROF_BINS - 1)) { bin = dur >> DM_PROF_BIN_SHIFT; }
+		if (prof.hist[bin] < 0xFFFF) { prof.hist[bin]++; }
+	}
+}
+
+
+void DotMatrix::getProfile(dm_profile_t* p)
+// Copy the refresh interrupt statistics (e. g. for a debugger or host simulator).
+{
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		*p = prof;
+	}
 }
 
 
+void DotMatrix::clearProfile()
+{
+	uint8_t i;
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		prof.samples = 0;
+		prof.dur_sum = 0;
+		prof.dur_min = 0xFFFF;
+		prof.dur_max = 0;
+		prof.lat_min = 0xFFFF;
+		prof.lat_max = 0;
+		prof.missed  = 0;
+		for (i = 0; i < DM_PROF_BINS; i++) { prof.hist[i] = 0; }
+	}
+}
+
+
+void DotMatrix::showProfile(const uint8_t x, const uint8_t y)
+// Draw the duration histogram as a bar graph (one column per bin, height
+// scaled to the largest bin) into the working screen.
+// Bins that reach the shortest refresh slot are drawn in red, the others in green.
+// A red pixel above the graph indicates missed compare matches.
+{
+	dm_profile_t	p;
+	uint16_t		max = 1;
+	uint8_t			i, h;
+	pixcol_t		pc;
+
+	getProfile(&p);
+	for (i = 0; i < DM_PROF_BINS; i++) {
+		if (p.hist[i] > max) { max = p.hist[i]; }
+	}
+	for (i = 0; i < DM_PROF_BINS; i++) {
+		h = ((uint32_t)p.hist[i] * ROWS_PER_BLOCK + max - 1) / max;	// bar height (round up)
+		pattern2PixCol(0xFF << (ROWS_PER_BLOCK - h),
+				(((uint16_t)(i + 1) << DM_PROF_BIN_SHIFT) > DM_SLOT_MIN) ? RED : GREEN, &pc);
+		setPixCol(x + i, y, &pc, OPAQUE);
+	}
+	if (p.missed) { setPixel(x, y - 1, RED); }
+}
+
+#endif
+
+
+void DotMatrix::render(const uint8_t idx)
+// Rebuild the output planes of pixel column idx of the working screen.
+// Has to be called whenever a pixel column of the working screen has been changed.
+{
+#ifdef DM_PHASE_PLANES
+	uint16_t	msb, lsb;
+	uint8_t		i;
+
+#ifdef DM_ROTATION
+	if (orient & DM_ROT_90) {			// the whole PixBlock changes
+		renderRot90(scr_wrk, idx & ~(COLS_PER_BLOCK - 1));
+		return;
+	}
+#endif
+	msb = scr_wrk[idx].msb;
+	lsb = scr_wrk[idx].lsb;
+	i = (scr_wrk - screen) + idx;
+	plane[PLANE_OR][i]  = msb | lsb;
+	plane[PLANE_AND][i] = msb & lsb;
+	plane[PLANE_MSB][i] = msb;
+#endif
+}
+
+
+#if defined(DM_ROTATION) && defined(DM_PHASE_PLANES)
+
+void DotMatrix::renderRot90(const scrcol_t* scr, const uint8_t first)
+// Rebuild the output planes of the PixBlock starting at pixel column first
+// of screen scr turned by 90 degrees clockwise: pixel (x, y) of the block is
+// shown at (7 - y, x).
+{
+	uint16_t	msb, lsb;
+	uint8_t		i, j, s, p;
+
+	for (j = 0; j < COLS_PER_BLOCK; j++) {			// output column
+		s = 2 * ((ROWS_PER_BLOCK - 1) - j);			// source row
+		msb = 0;
+		lsb = 0;
+		for (i = ROWS_PER_BLOCK; i-- > 0; ) {		// output row = source column
+			msb = (msb << 2) | ((scr[first + i].msb >> s) & 3);
+			lsb = (lsb << 2) | ((scr[first + i].lsb >> s) & 3);
+		}
+		p = (scr - screen) + first + j;
+		plane[PLANE_OR][p]  = msb | lsb;
+		plane[PLANE_AND][p] = msb & lsb;
+		plane[PLANE_MSB][p] = msb;
+	}
+}
+
+#endif
+
+
 void DotMatrix::clearScreen()
 {
 	uint8_t i;
 
 	for (i = 0; i < NUM_PIXCOLS; i++) {
+#ifdef DM_MONO
+		scr_wrk[i] = 0;
+#else
 		scr_wrk[i].msb = 0;
+#if DM_COLOR_DEPTH > 2
+		for (uint8_t k = 0; k < DM_COLOR_DEPTH - 2; k++) { scr_wrk[i].mid[k] = 0; }
+#endif
 		scr_wrk[i].lsb = 0;
+#endif
+		render(i);
+	}
+}
+
+
+void DotMatrix::copyScreen(const uint8_t vis_hid)
+// Copy screen vis_hid (VISIBLE or HIDDEN) to the working screen.
+{
+	const scrcol_t*	src = (vis_hid == HIDDEN) ? scr_hid : scr_vis;
+	uint8_t		i;
+
+	if (src == scr_wrk) { return; }
+	for (i = 0; i < NUM_PIXCOLS; i++) {
+		scr_wrk[i] = src[i];
+		render(i);
+	}
+}
+
+
+void DotMatrix::mergeScreen(const uint8_t vis_hid, const uint8_t mode)
+// Merge screen vis_hid (VISIBLE or HIDDEN) into the working screen
+// (see merge modes MERGE_OR, MERGE_XOR and MERGE_MASK).
+{
+	const scrcol_t*	src = (vis_hid == HIDDEN) ? scr_hid : scr_vis;
+	uint8_t		i;
+#ifndef DM_MONO
+	const uint16_t*	s;
+	uint16_t*	d;
+	uint16_t	m;
+	uint8_t		k;
+#endif
+
+	for (i = 0; i < NUM_PIXCOLS; i++) {
+#ifdef DM_MONO
+		if (mode == MERGE_XOR)			{ scr_wrk[i] ^= src[i]; }
+		else if (mode == MERGE_MASK)	{ scr_wrk[i] &= src[i]; }
+		else							{ scr_wrk[i] |= src[i]; }
+#else
+		s = &src[i].lsb;
+		d = &scr_wrk[i].lsb;
+		if (mode == MERGE_XOR) {
+			for (k = 0; k < DM_COLOR_DEPTH; k++) { d[k] ^= s[k]; }
+		}
+		else if (mode == MERGE_MASK) {
+			m = 0;
+			for (k = 0; k < DM_COLOR_DEPTH; k++) { m |= s[k]; }
+			m = (m | (m >> 1)) & 0x5555;		// pixels that are not black
+			m |= (m << 1);
+			for (k = 0; k < DM_COLOR_DEPTH; k++) { d[k] &= m; }
+		}
+		else {
+			for (k = 0; k < DM_COLOR_DEPTH; k++) { d[k] |= s[k]; }
+		}
+#endif
+		render(i);
+	}
+}
+
+
+uint8_t DotMatrix::fadeStep(const uint8_t vis_hid)
+// Move the brightness of each led of the working screen one level towards
+// screen vis_hid (VISIBLE or HIDDEN). Return 1 if both screens are equal
+// afterwards.
+// A cross-fade takes at most MAX_BRIGHTNESS steps, i. e. to fade over n frames
+// call fadeStep() every n / MAX_BRIGHTNESS frames (see getFrameCounter()).
+// The levels of 16 leds (8 red/green pixels) are compared and counted up or down at once
+// (bit-sliced over the bit planes of a pixel column).
+// With DM_MONO the screen is copied in one step.
+{
+	const scrcol_t*	src = (vis_hid == HIDDEN) ? scr_hid : scr_vis;
+	uint8_t		i;
+	uint8_t		done = 1;
+#ifndef DM_MONO
+	const uint16_t*	s;
+	uint16_t*	d;
+	uint16_t	gt, lt, eq, c;
+	uint8_t		k;
+#endif
+
+	for (i = 0; i < NUM_PIXCOLS; i++) {
+#ifdef DM_MONO
+		if (scr_wrk[i] != src[i]) {
+			scr_wrk[i] = src[i];
+			render(i);
+		}
+#else
+		s = &src[i].lsb;
+		d = &scr_wrk[i].lsb;
+		gt = 0;									// leds which are too bright
+		lt = 0;									// leds which are too dark
+		eq = 0xFFFF;
+		for (k = DM_COLOR_DEPTH; k-- > 0; ) {	// compare levels (msb first)
+			gt |= eq & d[k] & ~s[k];
+			lt |= eq & ~d[k] & s[k];
+			eq &= ~(d[k] ^ s[k]);
+		}
+		if (eq != 0xFFFF) {
+			eq = 0;
+			for (k = 0; k < DM_COLOR_DEPTH; k++) {	// +1 for lt, -1 for gt (lsb first)
+				c = d[k];
+				d[k] = c ^ (lt | gt);
+				lt &= c;						// carry
+				gt &= ~c;						// borrow
+				eq |= d[k] ^ s[k];				// remaining difference
+			}
+			if (eq) { done = 0; }
+			render(i);
+		}
+#endif
 	}
+	return (done);
 }
 
 
@@ -240,14 +1263,36 @@ void DotMatrix::swapScreen()
 // Exchange visible and hidden screen (if enabled).
 // Working screen is unaffected by this method, i. e. if you have been working
 // on the hidden screen future operations will still be working on the hidden screen.
+// The display switches to the new visible screen at the start of the next frame
+// (column 0), so a frame is never made up of both screens. Until then the new
+// hidden screen is still being shown: call waitForVsync() before drawing on it.
+{
+	scrcol_t *temp_screen;
+
+	ATOMIC_BLOCK(ATOMIC_FORCEON) {
+		temp_screen = scr_vis;
+		scr_vis = scr_hid;
+		scr_hid = temp_screen;
+		if (scr_wrk == scr_vis)	{ scr_wrk = scr_hid; }
+		else					{ scr_wrk = scr_vis; }
+		swap_req = 1;
+	}
+}
+
+
+void DotMatrix::waitForVsync()
+// Wait until the next frame starts and a pending screen swap has been carried out.
 {
-	pixcol_t *temp_screen;
+	uint8_t fc;
 
-	temp_screen = scr_vis;
-	scr_vis = scr_hid;
-	scr_hid = temp_screen;
-	if (scr_wrk == scr_vis)	{ scr_wrk = scr_hid; }
-	else					{ scr_wrk = scr_vis; }
+	fc = frame_cnt;
+#ifdef DM_COLUMN_RING
+	while (fc == frame_cnt) { fillRing(); }
+	while (swap_req) { fillRing(); }
+#else
+	while (fc == frame_cnt);
+	while (swap_req);
+#endif
 }
 
 
@@ -294,7 +1339,7 @@ uint8_t DotMatrix::displayText(const uint8_t x, const uint8_t y, const uint8_t m
 				}
 				else if (ch >= 16) {					// change color command?
 					if (ch == 16) { invert = ~invert; }
-					else { color = ch & 0xF; }			// change color
+					else { color = expandColor(ch & 0xF); }	// change color
 				}
 				continue;
 			}
@@ -343,10 +1388,118 @@ uint8_t DotMatrix::readChar(const char* ptr, const uint8_t src_mem_type)
 }
 
 
+void Ticker::start(const char* st, const uint8_t src_mem_type, const uint8_t y, const uint8_t mode)
+// Start scrolling text st (see displayText()) in pixel row y of the working screen.
+// The ticker continues at the current screen offset.
+{
+	text = st;
+	mem_type = src_mem_type;
+	row = y;
+	this->mode = mode;
+	rewind();
+}
+
+
+void Ticker::rewind()
+// restart at the beginning of the text with default font and color
+{
+	ptr = text;
+	w = 0;
+	invert = 0;
+	color = DEFAULT_COLOR;
+	char_base = DEFAULT_CHAR_BASE;
+	num_of_chars = DEFAULT_FONT_SIZE;
+	font = DEFAULT_FONT;
+}
+
+
+void Ticker::putPart(const uint16_t c, const uint8_t r, const uint8_t h, const uint8_t pattern)
+// Write the rows r..r+h-1 of screen column c (pattern is aligned to the block row).
+// The other rows of the column are left alone.
+{
+	uint8_t		x = c % DIM_X, y = (c / DIM_X) * ROWS_PER_BLOCK;
+	uint8_t		m = mode;
+	pixcol_t	pixcol;
+
+	if (m == OPAQUE) {									// clear the part, then draw it transparent
+		DotMatrix::clearRect(x, y + r, 1, h);
+		m = TRANSPARENT;
+	}
+	DotMatrix::pattern2PixCol(pattern, color, &pixcol);
+	DotMatrix::setPixCol(x, y, &pixcol, m);
+}
+
+
+uint8_t Ticker::step()
+// Scroll the ticker by one column.
+// The next pixel column of the text is written to the screen column that
+// enters at the right edge (block row of the ticker) and the offset is advanced.
+// At the end of the text the ticker starts over and 1 is returned.
+{
+	uint8_t		ch, ret = 0;
+	uint8_t		off = DotMatrix::getOffset();
+	uint8_t		yr = row & (ROWS_PER_BLOCK - 1);
+	uint16_t	c;
+	const unsigned char*	fp;
+	pixcol_t	pixcol;
+
+	while (w == 0) {									// fetch next character
+		ch = DotMatrix::readChar(ptr++, mem_type);
+		if (ch < 32) {
+			if (ch == 0) {								// end of text string -> start over
+				rewind();
+				if (ret) { return (ret); }				// text without printable characters
+				ret = 1;
+			}
+			else if (ch <= NUMBER_OF_FONTS) {			// switch font command?
+				ch--;
+				font = (const unsigned char* const*) pgm_read_word(&fonttable[ch]);
+				fp = &fontparams[2 * ch];
+				char_base    = pgm_read_byte(fp++);
+				num_of_chars = pgm_read_byte(fp);
+			}
+			else if (ch >= 16) {						// change color command?
+				if (ch == 16) { invert = ~invert; }
+				else { color = DotMatrix::expandColor(ch & 0xF); }
+			}
+			continue;
+		}
+		if (ch < char_base) { continue; }				// character code out of range
+		ch -= char_base;
+		if (ch >= num_of_chars) { continue; }			// character code out of range
+		p = (const unsigned char*) pgm_read_word(&font[ch]);
+		w = pgm_read_byte(p++);							// get character width
+	}
+
+	ch = pgm_read_byte(p++);
+	if (invert) { ch = ~ch; }
+	w--;
+
+	// After the offset has been advanced the right edge of block row b
+	// shows screen column (b + 1) * DIM_X + offset (wrapped).
+	c = ((row / ROWS_PER_BLOCK + 1) * DIM_X + off) % NUM_PIXCOLS;
+	if (row < DIM_Y) {									// text below the display is clipped
+		if (yr == 0) {
+			DotMatrix::pattern2PixCol(ch, color, &pixcol);
+			DotMatrix::setPixCol(c % DIM_X, (c / DIM_X) * ROWS_PER_BLOCK, &pixcol, mode);
+		}
+		else {											// text row spans two block rows
+			putPart(c, yr, ROWS_PER_BLOCK - yr, ch << yr);
+			if (row / ROWS_PER_BLOCK + 1 < NUM_BLOCKS_Y) {	// lower part is clipped below the last block row
+				putPart((c + DIM_X) % NUM_PIXCOLS, 0, yr, ch >> (ROWS_PER_BLOCK - yr));
+			}
+		}
+	}
+	DotMatrix::setOffset((off + 1) % NUM_PIXCOLS);
+	return (ret);
+}
+
+
 void DotMatrix::displayGraphics(const uint8_t x, const uint8_t y, const uint8_t mode, const uint16_t* graphics, const uint8_t src_mem_type,  const uint8_t len)
 // Display a graphics block on screen (origin = upper left corner).
 // The graphics block consists of <len> pixel columns.
 // Each pixel column is stored as two consecutive 16-bit values representing lsb and msb.
+// With DM_COLOR_DEPTH > 2 these 4 intensity levels are expanded to all bit planes.
 // ptr points to the data and src_mem_type specifies in which kind of memory (RAM, FLASH, EEPROM)
 // the data is stored.
 
@@ -374,6 +1527,13 @@ void DotMatrix::displayGraphics(const uint8_t x, const uint8_t y, const uint8_t
 		else if (src_mem_type == EXTERNAL) {	// read from external memory
 			pc.lsb = 0;  pc.msb = 0;		// replace this line with implementation
 		}
+	#endif
+	#if DM_COLOR_DEPTH > 2
+		pc.mid[DM_COLOR_DEPTH - 3] = pc.lsb;	// level 1 -> LEVEL_25, level 2 -> LEVEL_50
+		pc.lsb &= pc.msb;						// level 3 -> LEVEL_100
+		#if DM_COLOR_DEPTH > 3
+		pc.mid[0] = pc.lsb;
+		#endif
 	#endif
 		setPixCol(x + i, y, &pc, mode);
 	}
@@ -382,148 +1542,200 @@ void DotMatrix::displayGraphics(const uint8_t x, const uint8_t y, const uint8_t
 
 void DotMatrix::pattern2PixCol(const uint8_t pix_data, const uint8_t color, pixcol_t* pc)
 // Transform the 8 pixels in pix_data to a pixel column with given color.
+//
+// Estimated cost (avr-gcc -Os): table lookup about 10 cycles (bit operations
+// without DM_SPREAD_LUT about 35, former shift loop about 100) plus about
+// 12 cycles per bit plane for the color. For a ticker over the full width of
+// 2 PixBlocks (16 glyph columns) this saves about 1400 cycles per redraw.
 {
-	typedef union {
-		uint32_t u32;
-		struct {
-			uint8_t  u8lo;
-			uint16_t u16;
-			uint8_t  u8hi;
-		};
-	} shifter_t;
-
-	shifter_t	sh;
-	uint16_t	temp;
+	uint16_t	green, red;
+	uint16_t*	pl;
 	uint8_t		i;
+	uint8_t		col = color;
 
-	// spread pix_data, i. e. insert a 0 to the right of every bit
-	// e. g. 11011111 -> 1010001010101010
-	sh.u32 = pix_data;
-	for (i = 0; i < 8; i++) {
-		sh.u32 <<= 1;
-		sh.u16 <<= 1;
+	green = spread_bits(pix_data);
+	red = green << 1;
+
+	// set color bits of each bit plane (lsb first), masks instead of branches
+	pl = &pc->lsb;
+	for (i = 0; i < DM_COLOR_DEPTH; i++) {
+		*pl++ = (green & -(uint16_t)(col & GREEN_LSB)) | (red & -(uint16_t)((col & RED_LSB) >> DM_COLOR_DEPTH));
+		col >>= 1;
 	}
+}
 
-	// set most significant color bits
-	if (color & 0b0010) { temp =  sh.u16 >> 1; }
-	else { temp = 0; }
-	if (color & 0b1000) { temp |= sh.u16; }
-	pc->msb = temp;
 
-	// set least significant color bits
-	if (color & 0b0001) { temp =  sh.u16 >> 1; }
-	else { temp = 0; }
-	if (color & 0b0100) { temp |= sh.u16; }
-	pc->lsb = temp;
+static inline uint32_t shift_rows(const uint16_t data, const uint8_t rows)
+// Shift pixel column data down by rows (0..7) rows (2 bits per row) using
+// a byte move and a residual shift of at most 6 bits.
+{
+	uint32_t	t = data;
+
+	if (rows & 4) { t <<= 8; }
+	if (rows & 2) { t <<= 4; }
+	if (rows & 1) { t <<= 2; }
+	return (t);
 }
 
 
+#ifdef DM_MONO
+
 void DotMatrix::setPixCol(const uint8_t x, const uint8_t y, const pixcol_t* pc, const uint8_t mode)
 // Write a pixel column (8 bicolor-pixels) at the given position
-// in the working screen.
+// in the working screen. Each pixel with any led bit set is on.
 // origin (0, 0) = upper left corner
 {
-	typedef union {
-		uint32_t u32;
-		struct {
-			uint16_t lo;
-			uint16_t hi;
-		};
-	} split32_t;
+	uint8_t		idx;			// index to screen
+	uint8_t		yr;
+	uint8_t		k;
+	uint16_t	pix, mask;
+	const uint16_t*	src = &pc->lsb;
+
+	if (x >= DIM_X) { return; }
+	if (y >= DIM_Y) { return; }
+	idx = x + (y / ROWS_PER_BLOCK) * DIM_X;			// calculate index to screen
+	yr = y & (ROWS_PER_BLOCK - 1);					// remainder of y coordinate
+
+	pix = 0;
+	for (k = 0; k < DM_COLOR_DEPTH; k++) { pix |= src[k]; }
+	pix = (uint16_t)pack_bits(pix | (pix >> 1)) << yr;	// lower byte -> upper block
+	mask = (mode == TRANSPARENT) ? pix : (0xFF << yr);
 
+	for (k = 0; k < 2; k++) {
+		if (mode == XOR)	{ scr_wrk[idx] ^= (uint8_t)pix; }
+		else				{ scr_wrk[idx] = (scr_wrk[idx] & ~(uint8_t)mask) | (uint8_t)pix; }
+		render(idx);
+		idx += DIM_X;
+		if ((yr == 0) || (idx >= NUM_PIXCOLS)) { return; }
+		pix >>= 8;
+		mask >>= 8;
+	}
+}
+
+#else
+
+void DotMatrix::setPixCol(const uint8_t x, const uint8_t y, const pixcol_t* pc, const uint8_t mode)
+// Write a pixel column (8 bicolor-pixels) at the given position
+// in the working screen.
+// origin (0, 0) = upper left corner
+{
 	uint8_t		idx;			// index to screen
 	uint8_t		yr;
-	uint8_t		i;
-	split32_t	mask, pixel_lsb, pixel_msb;
+	uint8_t		k;
+	uint16_t	mask;
+	uint32_t	m, pixel[DM_COLOR_DEPTH];
+	const uint16_t*	src = &pc->lsb;
+	uint16_t*	dst;
+	uint16_t*	dst2;
 
 	if (x >= DIM_X) { return; }
 	if (y >= DIM_Y) { return; }
 	idx = x + (y / ROWS_PER_BLOCK) * DIM_X;			// calculate index to screen
 	yr = y & (ROWS_PER_BLOCK - 1);					// remainder of y coordinate
 
+	mask = 0xFFFF;
 	if (mode == TRANSPARENT) {						// calculate mask
-		mask.lo = (pc->lsb) | (pc->msb);
-		mask.lo |= ((mask.lo >> 1) & 0x5555);		// or-ing red and green bits
-		mask.lo |= (mask.lo << 1);
-	}
-	else {
-		mask.lo = 0xFFFF;
+		mask = 0;
+		for (k = 0; k < DM_COLOR_DEPTH; k++) { mask |= src[k]; }
+		mask = (mask | (mask >> 1)) & 0x5555;		// or-ing red and green bits
+		mask |= (mask << 1);
 	}
+	dst = &scr_wrk[idx].lsb;
 
-	pixel_lsb.lo = pc->lsb;
-	pixel_msb.lo = pc->msb;
-	for (i = 0; i < (yr * 2); i++) {				// shift mask and pixel data
-		mask.u32      <<= 1;
-		pixel_lsb.u32 <<= 1;
-		pixel_msb.u32 <<= 1;
+	if (yr == 0) {									// aligned: a single pixel column, no shifting
+		if (mode == XOR) {
+			for (k = 0; k < DM_COLOR_DEPTH; k++) { dst[k] ^= src[k]; }
+		}
+		else {
+			for (k = 0; k < DM_COLOR_DEPTH; k++) { dst[k] = (dst[k] & ~mask) | src[k]; }
+		}
+		render(idx);
+		return;
 	}
-	mask.u32 = ~mask.u32;
+
+	// the pixel column covers two PixBlocks (lower 16 bits -> upper block)
+	m = shift_rows(mask, yr);
+	for (k = 0; k < DM_COLOR_DEPTH; k++) { pixel[k] = shift_rows(src[k], yr); }
+	dst2 = 0;
+	if ((uint8_t)(idx + DIM_X) < (NUM_BLOCKS * COLS_PER_BLOCK)) { dst2 = &scr_wrk[idx + DIM_X].lsb; }
 
 	if (mode == XOR) {
-		scr_wrk[idx].lsb ^= pixel_lsb.lo;			// set new pixels
-		scr_wrk[idx].msb ^= pixel_msb.lo;
+		for (k = 0; k < DM_COLOR_DEPTH; k++) {
+			dst[k] ^= (uint16_t)pixel[k];
+			if (dst2) { dst2[k] ^= (uint16_t)(pixel[k] >> 16); }
+		}
 	}
 	else {
-		scr_wrk[idx].lsb &= mask.lo;				// clear pixels that are overwritten
-		scr_wrk[idx].msb &= mask.lo;
-		scr_wrk[idx].lsb |= pixel_lsb.lo;			// set new pixels
-		scr_wrk[idx].msb |= pixel_msb.lo;
-	}
-
-	if (yr) {
-		idx += DIM_X;
-		if (idx >= (NUM_BLOCKS * COLS_PER_BLOCK)) { return; }
-		if (mode == XOR) {
-			scr_wrk[idx].lsb ^= pixel_lsb.hi;		// set new pixels
-			scr_wrk[idx].msb ^= pixel_msb.hi;
-		}
-		else {
-			scr_wrk[idx].lsb &= mask.hi;			// clear pixels that are overwritten
-			scr_wrk[idx].msb &= mask.hi;
-			scr_wrk[idx].lsb |= pixel_lsb.hi;		// set new pixels
-			scr_wrk[idx].msb |= pixel_msb.hi;
+		for (k = 0; k < DM_COLOR_DEPTH; k++) {
+			dst[k] = (dst[k] & ~(uint16_t)m) | (uint16_t)pixel[k];
+			if (dst2) { dst2[k] = (dst2[k] & ~(uint16_t)(m >> 16)) | (uint16_t)(pixel[k] >> 16); }
 		}
 	}
+	render(idx);
+	if (dst2) { render(idx + DIM_X); }
 }
 
+#endif
+
 
 void DotMatrix::setPixel(uint8_t x, uint8_t y, const uint8_t color)
 // set pixel in working screen
+// (with DM_MONO the pixel is on for any color but BLACK)
 {
+#ifdef DM_MONO
+	uint8_t		bit = 1 << (y & (ROWS_PER_BLOCK - 1));
+#else
 	uint16_t	mask_red, mask_green, pix;
+	uint16_t*	pl;
+	uint8_t		k;
+	uint8_t		col = color;
 
 	mask_green = pgm_read_word(&pixcol_mask[y & (ROWS_PER_BLOCK - 1)]);
 	mask_red = mask_green << 1;
+#endif
 
 	if (x >= DIM_X) { return; }
 	if (y >= DIM_Y) { return; }
 	y /= ROWS_PER_BLOCK;
 	x = x + y * DIM_X;					// calculate index to screen
 
-	// set most significant color bits
-	pix = scr_wrk[x].msb & ~(mask_red | mask_green);	// clear pixel
-	if (color & 0b0010) { pix |=  mask_green; }
-	if (color & 0b1000) { pix |=  mask_red; }
-	scr_wrk[x].msb = pix;
-
-	// set least significant color bits
-	pix = scr_wrk[x].lsb & ~(mask_red | mask_green);	// clear pixel
-	if (color & 0b0001) { pix |=  mask_green; }
-	if (color & 0b0100) { pix |=  mask_red; }
-	scr_wrk[x].lsb = pix;
+#ifdef DM_MONO
+	if (color)	{ scr_wrk[x] |=  bit; }
+	else		{ scr_wrk[x] &= ~bit; }
+#else
+	// set color bits of each bit plane (lsb first)
+	pl = &scr_wrk[x].lsb;
+	for (k = 0; k < DM_COLOR_DEPTH; k++) {
+		pix = *pl & ~(mask_red | mask_green);	// clear pixel
+		if (col & GREEN_LSB) { pix |=  mask_green; }
+		if (col & RED_LSB)   { pix |=  mask_red; }
+		*pl++ = pix;
+		col >>= 1;
+	}
+#endif
+	render(x);
 }
 
 
 uint8_t DotMatrix::getPixel(uint8_t x, uint8_t y, const uint8_t vis_hid)
 // return color of specified pixel
 // return 255 if pixel coordinates are out of range
+// (with DM_COLOR_DEPTH = 4 this is also the code of ORANGE)
+// (with DM_MONO the color of a pixel that is on is the mono color)
 {
+#ifdef DM_MONO
+	uint8_t		bit = 1 << (y & (ROWS_PER_BLOCK - 1));
+	scrcol_t*	scr;
+#else
 	uint16_t	mask_red, mask_green;
 	uint8_t		color;
 	pixcol_t*	scr;
+	uint16_t*	pl;
+	uint8_t		k;
 
 	mask_green = pgm_read_word(&pixcol_mask[y & (ROWS_PER_BLOCK - 1)]);
 	mask_red = mask_green << 1;
+#endif
 
 	if (x >= DIM_X) { return(255); }
 	if (y >= DIM_Y) { return(255); }
@@ -533,17 +1745,590 @@ uint8_t DotMatrix::getPixel(uint8_t x, uint8_t y, const uint8_t vis_hid)
 	if (vis_hid == VISIBLE)		{ scr = scr_vis; }
 	else if (vis_hid == HIDDEN)	{ scr = scr_hid; }
 	else 						{ return(255); }
+#ifdef DM_MONO
+	return ((scr[x] & bit) ? mono_color : BLACK);
+#else
 	color = 0;
 
-	// get most significant color bits
-	if (scr[x].msb & mask_red)   { color |=  RED_MSB; }
-	if (scr[x].msb & mask_green) { color |=  GREEN_MSB; }
-
-	// get least significant color bits
-	if (scr[x].lsb & mask_red)   { color |=  RED_LSB; }
-	if (scr[x].lsb & mask_green) { color |=  GREEN_LSB; }
+	// get color bits of each bit plane (msb first)
+	pl = &scr[x].lsb;
+	for (k = DM_COLOR_DEPTH; k > 0; k--) {
+		color <<= 1;
+		if (pl[k - 1] & mask_red)   { color |=  RED_LSB; }
+		if (pl[k - 1] & mask_green) { color |=  GREEN_LSB; }
+	}
 
 	return(color);
+#endif
+}
+
+
+uint8_t DotMatrix::readRegion(const uint8_t x, const uint8_t y, const uint8_t w, const uint8_t h, const uint8_t vis_hid, uint8_t* occ, uint8_t* red, uint8_t* green)
+// Read the pixels of a rectangle of w x h pixels (h <= 8) with upper left
+// corner (x, y) of the specified screen as bit masks, one byte per column
+// (bit r = row y + r): occ = pixel is not black, red / green = led is on.
+// Each of the arrays occ, red and green (w bytes) may be 0 if not needed.
+// Pixels outside the screen are returned as black.
+// Return the or-ed occupancy of all columns (0 = region is black).
+{
+	const scrcol_t*	scr = (vis_hid == HIDDEN) ? scr_hid : scr_vis;
+	uint8_t		c, idx, yr, rmask, o, r, g, any;
+#ifdef DM_MONO
+	uint16_t	d;
+#else
+	uint32_t	d;
+	uint16_t	on;
+	uint8_t		k;
+#endif
+
+	rmask = (h >= ROWS_PER_BLOCK) ? 0xFF : ((1 << h) - 1);
+	yr = y & (ROWS_PER_BLOCK - 1);
+	any = 0;
+	for (c = 0; c < w; c++) {
+		o = r = g = 0;
+		if ((x + c < DIM_X) && (y < DIM_Y)) {
+			idx = x + c + (y / ROWS_PER_BLOCK) * DIM_X;
+#ifdef DM_MONO
+			d = scr[idx];
+			if (idx + DIM_X < NUM_PIXCOLS) { d |= (uint16_t)scr[idx + DIM_X] << 8; }	// block row below
+			o = (d >> yr) & rmask;
+			if (mono_color & RED)   { r = o; }
+			if (mono_color & GREEN) { g = o; }
+#else
+			d = 0;
+			for (k = 0; k < DM_COLOR_DEPTH; k++) {	// leds which are on
+				d |= (&scr[idx].lsb)[k];
+				if (idx + DIM_X < NUM_PIXCOLS) { d |= (uint32_t)(&scr[idx + DIM_X].lsb)[k] << 16; }
+			}
+			on = d >> (2 * yr);
+			r = pack_bits(on >> 1) & rmask;
+			g = pack_bits(on) & rmask;
+			o = r | g;
+#endif
+		}
+		if (occ)   { occ[c] = o; }
+		if (red)   { red[c] = r; }
+		if (green) { green[c] = g; }
+		any |= o;
+	}
+	return (any);
+}
+
+
+void DotMatrix::transpose8(uint8_t* m)
+// Transpose the 8x8 bit matrix m in place: bit i of m[j] is swapped with bit j of m[i].
+// Shift/mask ladder on two 32-bit halves (3 steps instead of 64 single bit moves).
+{
+	uint32_t	lo, hi, t;
+
+	lo = m[0] | ((uint16_t)m[1] << 8) | ((uint32_t)m[2] << 16) | ((uint32_t)m[3] << 24);
+	hi = m[4] | ((uint16_t)m[5] << 8) | ((uint32_t)m[6] << 16) | ((uint32_t)m[7] << 24);
+
+	t = (lo ^ (lo >> 7)) & 0x00AA00AA;				// swap 1x1 blocks
+	lo ^= t ^ (t << 7);
+	t = (hi ^ (hi >> 7)) & 0x00AA00AA;
+	hi ^= t ^ (t << 7);
+	t = (lo ^ (lo >> 14)) & 0x0000CCCC;				// swap 2x2 blocks
+	lo ^= t ^ (t << 14);
+	t = (hi ^ (hi >> 14)) & 0x0000CCCC;
+	hi ^= t ^ (t << 14);
+	t = (lo ^ (hi << 4)) & 0xF0F0F0F0;				// swap 4x4 blocks
+	lo ^= t;
+	hi ^= t >> 4;
+
+	m[0] = lo;  m[1] = lo >> 8;  m[2] = lo >> 16;  m[3] = lo >> 24;
+	m[4] = hi;  m[5] = hi >> 8;  m[6] = hi >> 16;  m[7] = hi >> 24;
+}
+
+
+#ifdef DM_MONO
+
+uint8_t DotMatrix::getRow(const uint8_t x, const uint8_t y, const uint8_t color_bit, const uint8_t vis_hid)
+// Return the pixels (x..x+7, y) of the specified screen as a byte (bit i = pixel x + i).
+// Pixels outside the screen are returned as 0. color_bit is not used.
+{
+	const scrcol_t*	scr;
+	uint8_t		i, bit, data;
+
+	if (y >= DIM_Y) { return (0); }
+	bit = 1 << (y & (ROWS_PER_BLOCK - 1));
+	scr = &((vis_hid == HIDDEN) ? scr_hid : scr_vis)[(y / ROWS_PER_BLOCK) * DIM_X];
+	data = 0;
+	for (i = 0; (i < 8) && (x + i < DIM_X); i++) {
+		if (scr[x + i] & bit) { data |= (1 << i); }
+	}
+	return (data);
+}
+
+
+void DotMatrix::setRow(const uint8_t x, const uint8_t y, const uint8_t color_bit, const uint8_t data)
+// Write the pixels (x..x+7, y) in working screen (bit i of data = pixel x + i).
+// color_bit is not used.
+{
+	uint8_t		i, bit, idx;
+
+	if (y >= DIM_Y) { return; }
+	bit = 1 << (y & (ROWS_PER_BLOCK - 1));
+	idx = x + (y / ROWS_PER_BLOCK) * DIM_X;
+	for (i = 0; (i < 8) && (x + i < DIM_X); i++, idx++) {
+		if (data & (1 << i)) { scr_wrk[idx] |= bit; }
+		else                 { scr_wrk[idx] &= ~bit; }
+		render(idx);
+	}
+}
+
+
+void DotMatrix::getRows(const uint8_t x, const uint8_t y, const uint8_t color_bit, uint8_t* rows, const uint8_t vis_hid)
+// Read the 8 rows of the PixBlock row containing y (rows[r] = row r of the
+// PixBlock row, columns x..x+7, see getRow()) with one transposition.
+{
+	const scrcol_t*	scr;
+	uint8_t		c;
+
+	for (c = 0; c < 8; c++) { rows[c] = 0; }
+	if (y >= DIM_Y) { return; }
+	scr = &((vis_hid == HIDDEN) ? scr_hid : scr_vis)[(y / ROWS_PER_BLOCK) * DIM_X];
+	for (c = 0; (c < 8) && (x + c < DIM_X); c++) { rows[c] = scr[x + c]; }
+	transpose8(rows);								// columns -> rows
+}
+
+
+void DotMatrix::setRows(const uint8_t x, const uint8_t y, const uint8_t color_bit, const uint8_t* rows)
+// Write the 8 rows of the PixBlock row containing y in working screen
+// (rows[r] = row r of the PixBlock row, columns x..x+7, see setRow()).
+{
+	uint8_t		cols[8];
+	uint8_t		c, idx;
+
+	if (y >= DIM_Y) { return; }
+	for (c = 0; c < 8; c++) { cols[c] = rows[c]; }
+	transpose8(cols);								// rows -> columns
+	idx = x + (y / ROWS_PER_BLOCK) * DIM_X;
+	for (c = 0; (c < 8) && (x + c < DIM_X); c++, idx++) {
+		scr_wrk[idx] = cols[c];
+		render(idx);
+	}
+}
+
+#else
+
+uint8_t DotMatrix::getRow(const uint8_t x, const uint8_t y, const uint8_t color_bit, const uint8_t vis_hid)
+// Return one bit of the color code (see setRow()) of the pixels (x..x+7, y)
+// of the specified screen as a byte (bit i = pixel x + i).
+// Pixels outside the screen are returned as 0.
+{
+	const uint16_t*	pl;
+	uint16_t	mask;
+	uint8_t		i, data;
+
+	if (y >= DIM_Y) { return (0); }
+	mask = pgm_read_word(&pixcol_mask[y & (ROWS_PER_BLOCK - 1)]);
+	if (color_bit >= DM_COLOR_DEPTH) { mask <<= 1; }	// red led
+	pl = &((vis_hid == HIDDEN) ? scr_hid : scr_vis)[(y / ROWS_PER_BLOCK) * DIM_X].lsb + (color_bit % DM_COLOR_DEPTH);
+	data = 0;
+	for (i = 0; (i < 8) && (x + i < DIM_X); i++) {
+		if (pl[(x + i) * PIXCOL_WORDS] & mask) { data |= (1 << i); }
+	}
+	return (data);
+}
+
+
+void DotMatrix::setRow(const uint8_t x, const uint8_t y, const uint8_t color_bit, const uint8_t data)
+// Write one bit of the color code of the pixels (x..x+7, y) in working screen
+// (bit i of data = pixel x + i).
+// color_bit: 0..DM_COLOR_DEPTH-1 = green led, DM_COLOR_DEPTH..2*DM_COLOR_DEPTH-1 = red led
+// (lsb first, i. e. the bit numbers of the color code)
+{
+	uint16_t*	pl;
+	uint16_t	mask;
+	uint8_t		i, idx;
+
+	if (y >= DIM_Y) { return; }
+	mask = pgm_read_word(&pixcol_mask[y & (ROWS_PER_BLOCK - 1)]);
+	if (color_bit >= DM_COLOR_DEPTH) { mask <<= 1; }
+	idx = x + (y / ROWS_PER_BLOCK) * DIM_X;
+	for (i = 0; (i < 8) && (x + i < DIM_X); i++, idx++) {
+		pl = &scr_wrk[idx].lsb + (color_bit % DM_COLOR_DEPTH);
+		if (data & (1 << i)) { *pl |= mask; }
+		else                 { *pl &= ~mask; }
+		render(idx);
+	}
+}
+
+
+void DotMatrix::getRows(const uint8_t x, const uint8_t y, const uint8_t color_bit, uint8_t* rows, const uint8_t vis_hid)
+// Read the 8 rows of the PixBlock row containing y (rows[r] = row r of the
+// PixBlock row, columns x..x+7, see getRow()) with one transposition.
+{
+	const uint16_t*	pl;
+	uint8_t		c, led;
+
+	for (c = 0; c < 8; c++) { rows[c] = 0; }
+	if (y >= DIM_Y) { return; }
+	led = (color_bit >= DM_COLOR_DEPTH);
+	pl = &((vis_hid == HIDDEN) ? scr_hid : scr_vis)[(y / ROWS_PER_BLOCK) * DIM_X].lsb + (color_bit % DM_COLOR_DEPTH);
+	for (c = 0; (c < 8) && (x + c < DIM_X); c++) {
+		rows[c] = pack_bits(pl[(x + c) * PIXCOL_WORDS] >> led);
+	}
+	transpose8(rows);								// columns -> rows
+}
+
+
+void DotMatrix::setRows(const uint8_t x, const uint8_t y, const uint8_t color_bit, const uint8_t* rows)
+// Write the 8 rows of the PixBlock row containing y in working screen
+// (rows[r] = row r of the PixBlock row, columns x..x+7, see setRow()).
+{
+	uint8_t		cols[8];
+	uint16_t*	pl;
+	uint16_t	mask;
+	uint8_t		c, led, idx;
+
+	if (y >= DIM_Y) { return; }
+	for (c = 0; c < 8; c++) { cols[c] = rows[c]; }
+	transpose8(cols);								// rows -> columns
+	led = (color_bit >= DM_COLOR_DEPTH);
+	mask = 0x5555 << led;
+	idx = x + (y / ROWS_PER_BLOCK) * DIM_X;
+	for (c = 0; (c < 8) && (x + c < DIM_X); c++, idx++) {
+		pl = &scr_wrk[idx].lsb + (color_bit % DM_COLOR_DEPTH);
+		*pl = (*pl & ~mask) | (spread_bits(cols[c]) << led);
+		render(idx);
+	}
+}
+
+#endif
+
+
+#ifndef DM_MONO
+
+static inline void adjust_levels(uint16_t* pl, const uint16_t* pat, uint16_t mask, const uint8_t mode)
+// Change the brightness levels of the leds selected by mask in the bit planes pl
+// (bit-sliced, all leds of the pixel column at once, saturating):
+// RECT_DIM      = one level darker
+// RECT_BRIGHTEN = one level brighter
+// RECT_CLAMP    = limit each led to its level in pat (bit planes of a color)
+{
+	uint16_t	c, gt, eq;
+	uint8_t		k;
+
+	if (mode == RECT_CLAMP) {
+		gt = 0;										// leds brighter than pat
+		eq = mask;
+		for (k = DM_COLOR_DEPTH; k-- > 0; ) {		// msb first
+			gt |= eq & pl[k] & ~pat[k];
+			eq &= ~(pl[k] ^ pat[k]);
+		}
+		for (k = 0; k < DM_COLOR_DEPTH; k++) { pl[k] = (pl[k] & ~gt) | (pat[k] & gt); }
+		return;
+	}
+	if (mode == RECT_DIM) {
+		c = 0;
+		for (k = 0; k < DM_COLOR_DEPTH; k++) { c |= pl[k]; }	// leds which are on
+		mask &= c;
+		for (k = 0; k < DM_COLOR_DEPTH; k++) {		// -1 (lsb first)
+			c = pl[k];
+			pl[k] = c ^ mask;
+			mask &= ~c;								// borrow
+		}
+	}
+	else {
+		c = 0xFFFF;
+		for (k = 0; k < DM_COLOR_DEPTH; k++) { c &= pl[k]; }	// leds at MAX_BRIGHTNESS
+		mask &= ~c;
+		for (k = 0; k < DM_COLOR_DEPTH; k++) {		// +1 (lsb first)
+			c = pl[k];
+			pl[k] = c ^ mask;
+			mask &= c;								// carry
+		}
+	}
+}
+
+#endif
+
+
+void DotMatrix::rect(const uint8_t x, const uint8_t y, const uint8_t w, const uint8_t h, uint8_t color, const uint8_t mode)
+// Fill (mode OPAQUE) or invert (mode XOR, color = 0xFF) a rectangle of w x h pixels
+// with upper left corner (x, y) in working screen or change the brightness of
+// its leds (modes RECT_DIM, RECT_BRIGHTEN and RECT_CLAMP, see adjust_levels()).
+// The rectangle is clipped to the screen. Each pixel column of a PixBlock row
+// is changed with a single mask per bit plane.
+// (with DM_MONO the pixels are switched on for any color but BLACK,
+// RECT_DIM switches them off, RECT_BRIGHTEN on)
+{
+#ifndef DM_MONO
+	uint16_t	pat[DM_COLOR_DEPTH];
+	uint16_t*	pl;
+	uint8_t		k;
+#endif
+	uint16_t	mask;
+	uint8_t		x1, y1, r0, r1, idx, row;
+
+	if ((x >= DIM_X) || (y >= DIM_Y)) { return; }
+	if ((w == 0) || (h == 0)) { return; }
+	x1 = (w < DIM_X - x) ? x + w : DIM_X;			// clip (x1, y1 exclusive)
+	y1 = (h < DIM_Y - y) ? y + h : DIM_Y;
+
+#ifndef DM_MONO
+	// color bits of each bit plane (lsb first)
+	for (k = 0; k < DM_COLOR_DEPTH; k++) {
+		pat[k] = 0;
+		if (color & GREEN_LSB) { pat[k] |= 0x5555; }
+		if (color & RED_LSB)   { pat[k] |= 0xAAAA; }
+		color >>= 1;
+	}
+#endif
+
+	for (row = y / ROWS_PER_BLOCK; row <= (y1 - 1) / ROWS_PER_BLOCK; row++) {
+		r0 = 0;
+		r1 = ROWS_PER_BLOCK - 1;
+		if (row == y / ROWS_PER_BLOCK)        { r0 = y & (ROWS_PER_BLOCK - 1); }
+		if (row == (y1 - 1) / ROWS_PER_BLOCK) { r1 = (y1 - 1) & (ROWS_PER_BLOCK - 1); }
+#ifdef DM_MONO
+		mask = (0xFF << r0) & (0xFF >> (ROWS_PER_BLOCK - 1 - r1));	// rows r0..r1
+
+		for (idx = x + row * DIM_X; idx < x1 + row * DIM_X; idx++) {
+			if (mode == XOR)										{ scr_wrk[idx] ^= mask; }
+			else if ((mode == RECT_BRIGHTEN) || (color && (mode == OPAQUE)))	{ scr_wrk[idx] |= mask; }
+			else if ((mode == RECT_DIM) || !color)					{ scr_wrk[idx] &= ~mask; }	// (RECT_CLAMP to BLACK)
+			render(idx);
+		}
+#else
+		mask = (0xFFFF << (2 * r0)) & (0xFFFF >> (2 * (ROWS_PER_BLOCK - 1 - r1)));	// rows r0..r1
+
+		idx = x + row * DIM_X;
+		if (mode == XOR) {
+			for (; idx < x1 + row * DIM_X; idx++) {
+				pl = &scr_wrk[idx].lsb;
+				for (k = 0; k < DM_COLOR_DEPTH; k++) { pl[k] ^= pat[k] & mask; }
+				render(idx);
+			}
+		}
+		else if (mode == OPAQUE) {
+			for (; idx < x1 + row * DIM_X; idx++) {
+				pl = &scr_wrk[idx].lsb;
+				for (k = 0; k < DM_COLOR_DEPTH; k++) { pl[k] = (pl[k] & ~mask) | (pat[k] & mask); }
+				render(idx);
+			}
+		}
+		else {
+			for (; idx < x1 + row * DIM_X; idx++) {
+				adjust_levels(&scr_wrk[idx].lsb, pat, mask, mode);
+				render(idx);
+			}
+		}
+#endif
+	}
+}
+
+
+void DotMatrix::span(const int16_t x, int16_t y0, int16_t y1, const uint8_t color)
+// Set the pixels (x, y0..y1) in working screen (clipped).
+// All pixels of the span within a PixBlock are written at once (see rect()).
+{
+	int16_t		t;
+
+	if (y0 > y1) { t = y0;  y0 = y1;  y1 = t; }
+	if ((x < 0) || (x >= DIM_X) || (y1 < 0) || (y0 >= DIM_Y)) { return; }
+	if (y0 < 0) { y0 = 0; }
+	if (y1 >= DIM_Y) { y1 = DIM_Y - 1; }
+	rect(x, y0, 1, y1 - y0 + 1, color, OPAQUE);
+}
+
+
+void DotMatrix::drawLine(int16_t x0, int16_t y0, const int16_t x1, const int16_t y1, const uint8_t color)
+// Draw a line from (x0, y0) to (x1, y1) in working screen (Bresenham).
+// The line is drawn from left to right and the pixels of each column are
+// collected into a span, so each column is written once.
+// Coordinates may be off-screen (-16384..16383), the line is clipped.
+{
+	int16_t		xe = x1, ye = y1;
+	int16_t		dx, dy, sy, ys;
+	int32_t		err, e2;							// 2 * err exceeds 16 bits for long lines
+
+	if (x0 > xe) {									// draw from left to right
+		xe = x0;  x0 = x1;
+		ye = y0;  y0 = y1;
+	}
+	dx = xe - x0;
+	dy = (ye > y0) ? (ye - y0) : (y0 - ye);
+	sy = (ye > y0) ? 1 : -1;
+	err = dx - dy;
+	ys = y0;										// first row of the current span
+
+	while ((x0 != xe) || (y0 != ye)) {
+		e2 = 2 * err;
+		if (e2 >= -dy) {								// next pixel is in the next column
+			span(x0, ys, y0, color);
+			if (x0 >= DIM_X - 1) { return; }		// rest of the line is off-screen
+			err -= dy;
+			x0++;
+			if (e2 <= dx) {
+				err += dx;
+				y0 += sy;
+			}
+			ys = y0;
+		}
+		else {
+			err += dx;
+			y0 += sy;
+		}
+	}
+	span(x0, ys, y0, color);
+}
+
+
+void DotMatrix::drawCircle(const int16_t xc, const int16_t yc, const int16_t r, const uint8_t color)
+// Draw a circle with center (xc, yc) and radius r in working screen (midpoint algorithm).
+// (a, b) runs through the first octant. Columns xc +- a get the single
+// pixels yc +- b, columns xc +- b get the spans yc +- (a0..a) that share
+// the same b. The circle is clipped.
+{
+	int16_t		a = 0, b = r, a0 = 0;
+	int16_t		d = 1 - r;
+
+	if (r < 0) { return; }
+	while (a <= b) {
+		span(xc + a, yc - b, yc - b, color);
+		span(xc + a, yc + b, yc + b, color);
+		span(xc - a, yc - b, yc - b, color);
+		span(xc - a, yc + b, yc + b, color);
+		if (d < 0) {
+			d += 2 * a + 3;
+		}
+		else {										// b changes -> write columns xc +- b
+			d += 2 * (a - b) + 5;
+			span(xc + b, yc + a0, yc + a, color);
+			span(xc + b, yc - a0, yc - a, color);
+			span(xc - b, yc + a0, yc + a, color);
+			span(xc - b, yc - a0, yc - a, color);
+			b--;
+			a0 = a + 1;
+		}
+		a++;
+	}
+	if (a0 < a) {									// columns of the last b
+		span(xc + b, yc + a0, yc + a - 1, color);
+		span(xc + b, yc - a0, yc - a + 1, color);
+		span(xc - b, yc + a0, yc + a - 1, color);
+		span(xc - b, yc - a0, yc - a + 1, color);
+	}
+}
+
+
+void DotMatrix::fillPolygon(const int16_t* xy, const uint8_t n, const uint8_t color)
+// Fill the polygon with the n vertices xy = {x0, y0, x1, y1, ...} (n <= DM_POLY_MAX)
+// in working screen. For each column the crossings of the edges are computed
+// and the rows in between are written as spans (even-odd rule).
+// Like fillRect() the pixels on the right and bottom edges are not set,
+// e. g. {0, 0, 4, 0, 4, 4, 0, 4} fills 4 x 4 pixels. The polygon is clipped.
+// Nothing is drawn if n < 3 or n > DM_POLY_MAX.
+{
+	int16_t		yc[DM_POLY_MAX];			// rows where the edges cross the column
+	int16_t		x, xmin, xmax, xa, ya, xb, yb, t;
+	int32_t		num;
+	uint8_t		i, j, k;
+
+	if ((n < 3) || (n > DM_POLY_MAX)) { return; }	// nothing drawn
+	xmin = xmax = xy[0];
+	for (i = 1; i < n; i++) {
+		if (xy[2 * i] < xmin) { xmin = xy[2 * i]; }
+		if (xy[2 * i] > xmax) { xmax = xy[2 * i]; }
+	}
+	if (xmin < 0) { xmin = 0; }
+	if (xmax > DIM_X) { xmax = DIM_X; }
+
+	for (x = xmin; x < xmax; x++) {
+		k = 0;
+		for (i = 0; i < n; i++) {
+			j = (i + 1 < n) ? i + 1 : 0;
+			xa = xy[2 * i];  ya = xy[2 * i + 1];
+			xb = xy[2 * j];  yb = xy[2 * j + 1];
+			if (xa > xb) { t = xa;  xa = xb;  xb = t;  t = ya;  ya = yb;  yb = t; }
+			if ((x < xa) || (x >= xb)) { continue; }		// edge does not cross the column
+			num = (int32_t)(x - xa) * (yb - ya);
+			if (num >= 0)	{ t = ya + (num + (xb - xa) - 1) / (xb - xa); }	// first row below the edge
+			else			{ t = ya - (-num / (xb - xa)); }
+			for (j = k++; (j > 0) && (yc[j - 1] > t); j--) { yc[j] = yc[j - 1]; }	// insertion sort
+			yc[j] = t;
+		}
+		for (i = 0; i + 1 < k; i += 2) {
+			if (yc[i + 1] > yc[i]) { span(x, yc[i], yc[i + 1] - 1, color); }
+		}
+	}
+}
+
+
+#ifdef DM_SPRITES
+
+void DotMatrix::showSprite(dm_sprite_t* s, const uint16_t* data, const int8_t x, const int8_t y)
+// Draw sprite data (in flash) with upper left corner (x, y) into working screen.
+// The covered pixels are saved in s and restored by hideSprite().
+// If s is already shown it is removed first, i. e. the sprite is moved.
+// Overlapping sprites have to be hidden in reverse order of drawing.
+{
+	if (s->shown) { drawSprite(s, 1); }
+	s->data = data;
+	s->x = x;
+	s->y = y;
+	s->shown = 1;
+	drawSprite(s, 0);
+}
+
+
+void DotMatrix::hideSprite(dm_sprite_t* s)
+// Restore the pixels covered by sprite s.
+// The working screen has to be the same as for showSprite().
+{
+	if (s->shown) { drawSprite(s, 1); }
+	s->shown = 0;
+}
+
+
+void DotMatrix::drawSprite(dm_sprite_t* s, const uint8_t restore)
+// Draw sprite s (restore = 0) or restore its background (restore = 1).
+// Only the pixel columns covered by the sprite are touched.
+{
+	const uint16_t*	src = s->data;
+	uint32_t	m, pixel[DM_COLOR_DEPTH];
+	uint16_t	hm;
+	uint16_t*	dst;
+	uint16_t*	sv;
+	uint8_t		w, c, h, k, idx, yr;
+	int8_t		sx, row;
+
+	w = pgm_read_word(src++);
+	if (w > DM_SPRITE_WIDTH) { w = DM_SPRITE_WIDTH; }
+	yr = s->y & (ROWS_PER_BLOCK - 1);
+	row = (s->y - (int8_t)yr) / ROWS_PER_BLOCK;		// PixBlock row of the upper half
+
+	for (c = 0; c < w; c++, src += DM_COLOR_DEPTH + 1) {
+		sx = s->x + c;
+		if ((sx < 0) || (sx >= DIM_X)) { continue; }	// clipped
+		m = shift_rows(pgm_read_word(src), yr);
+		if (!restore) {
+			for (k = 0; k < DM_COLOR_DEPTH; k++) { pixel[k] = shift_rows(pgm_read_word(src + 1 + k), yr); }
+		}
+		for (h = 0; h < 2; h++) {
+			if (((row + h) < 0) || ((row + h) >= NUM_BLOCKS_Y)) { continue; }	// clipped
+			hm = h ? (uint16_t)(m >> 16) : (uint16_t)m;
+			if (hm == 0) { continue; }
+			idx = sx + (row + h) * DIM_X;
+			dst = &scr_wrk[idx].lsb;
+			sv = &s->under[2 * c + h].lsb;
+			if (restore) {
+				for (k = 0; k < DM_COLOR_DEPTH; k++) { dst[k] = (dst[k] & ~hm) | (sv[k] & hm); }
+			}
+			else {
+				for (k = 0; k < DM_COLOR_DEPTH; k++) {
+					sv[k] = dst[k];
+					dst[k] = (dst[k] & ~hm) | ((h ? (uint16_t)(pixel[k] >> 16) : (uint16_t)pixel[k]) & hm);
+				}
+			}
+			render(idx);
+		}
+	}
 }
 
+#endif
+
 
@@ -31,6 +31,8 @@ Disclaimer:			This software is provided by the copyright holder "as is" and any
 /*
  * Each pixel has two leds, red and green.
  * Each led has four brightness levels (off, 25% on, 50% on, 100% on)
+ * (with DM_BCM: off, 33% on, 67% on, 100% on).
+ * With DM_COLOR_DEPTH = 3 or 4 each led has 8 or 16 brightness levels.
  *
  * screen:
  * Array that contains the pixel columns which are of type pixcol_t.
@@ -39,6 +41,7 @@ Disclaimer:			This software is provided by the copyright holder "as is" and any
  * A pixel column is a column of 8 bi-colored pixels.
  * The pixel column contains two 16-bit values - one for the MSBs and one
  * for the LSBs of the brightnesses of the corresponding leds.
+ * With DM_COLOR_DEPTH > 2 the intermediate bits are stored in between.
  * The bits of each 16-bit value are assigned to the leds as follows:
  * bit 15 = bottom pixel red led
  * bit 14 = bottom pixel green led
@@ -46,6 +49,9 @@ Disclaimer:			This software is provided by the copyright holder "as is" and any
  * bit 1 = top pixel red led
  * bit 0 = top pixel green led
  *
+ * With DM_MONO the screen holds one byte per pixel column instead
+ * (bit 0 = top pixel) and all pixels that are on share one color.
+ *
  * The origin of the pixel coordinate system is in the upper left corner.
  */
 
@@ -70,35 +76,80 @@ Disclaimer:			This software is provided by the copyright holder "as is" and any
 // bit1 = green led, most  significant intensity bit
 // bit2 = red   led, least significant intensity bit
 // bit3 = red   led, most  significant intensity bit
-#define RED				0b1100
-#define LIGHTRED		0b1101
-#define REDORANGE		0b1110
-#define ORANGE			0b1111
-#define LIGHTORANGE		0b1011
-#define YELLOW			0b0111
-#define GREEN			0b0011
-#define MEDIUMRED		0b1000
-#define MEDIUMORANGE	0b1010
-#define MEDIUMGREEN		0b0010
-#define DARKRED			0b0100
-#define DARKORANGE		0b0101
-#define DARKGREEN		0b0001
-#define BLACK			0b0000
-
-#define RED_MSB			0b1000
-#define RED_LSB			0b0100
-#define GREEN_MSB		0b0010
-#define GREEN_LSB		0b0001
+// With DM_COLOR_DEPTH = 3 (4) a color has 6 (8) bits, the lower half for the
+// green led and the upper half for the red led. The colors below are scaled
+// accordingly. Text color commands always use the 4 bit color code (see COLOR_CODE).
+#define DM_COLOR_DEPTH	2		// number of bit planes per led (2, 3 or 4)
+
+#define LEVEL_25		(1 << (DM_COLOR_DEPTH - 2))		// intensity 25 %
+#define LEVEL_50		(2 << (DM_COLOR_DEPTH - 2))		// intensity 50 %
+#define LEVEL_100		((1 << DM_COLOR_DEPTH) - 1)		// intensity 100 %
+#define RG_COLOR(red, green)	(((red) << DM_COLOR_DEPTH) | (green))
+#define COLOR_CODE(color)		((((color) >> (2 * DM_COLOR_DEPTH - 4)) & 0b1100) | (((color) >> (DM_COLOR_DEPTH - 2)) & 0b0011))
+
+#define RED				RG_COLOR(LEVEL_100, 0)
+#define LIGHTRED		RG_COLOR(LEVEL_100, LEVEL_25)
+#define REDORANGE		RG_COLOR(LEVEL_100, LEVEL_50)
+#define ORANGE			RG_COLOR(LEVEL_100, LEVEL_100)
+#define LIGHTORANGE		RG_COLOR(LEVEL_50,  LEVEL_100)
+#define YELLOW			RG_COLOR(LEVEL_25,  LEVEL_100)
+#define GREEN			RG_COLOR(0,         LEVEL_100)
+#define MEDIUMRED		RG_COLOR(LEVEL_50,  0)
+#define MEDIUMORANGE	RG_COLOR(LEVEL_50,  LEVEL_50)
+#define MEDIUMGREEN		RG_COLOR(0,         LEVEL_50)
+#define DARKRED			RG_COLOR(LEVEL_25,  0)
+#define DARKORANGE		RG_COLOR(LEVEL_25,  LEVEL_25)
+#define DARKGREEN		RG_COLOR(0,         LEVEL_25)
+#define BLACK			0
+
+#define RED_MSB			(1 << (2 * DM_COLOR_DEPTH - 1))
+#define RED_LSB			(1 << DM_COLOR_DEPTH)
+#define GREEN_MSB		(1 << (DM_COLOR_DEPTH - 1))
+#define GREEN_LSB		1
+
+// palette colors (with DM_PALETTE)
+// A pixel drawn with color DM_PAL(i) shows palette entry i (0..3). Only the lsb
+// bit plane is used: bit 0 of the index on the green led, bit 1 on the red led.
+#define DM_PAL(i)			RG_COLOR(((i) >> 1) & 1, (i) & 1)
+#define DM_PAL_INDEX(color)	(((color) & 1) | (((color) >> (DM_COLOR_DEPTH - 1)) & 2))	// inverse of DM_PAL()
 
 // display modes
 #define OPAQUE			0	// black pixels are opaque
 #define TRANSPARENT		1	// each black pixel is considered to be transparent
 #define XOR				2	// xor pixels with background
 
+// brightness operations on rectangles (see rect())
+#define RECT_DIM		3	// one level darker (0 stays 0)
+#define RECT_BRIGHTEN	4	// one level brighter (MAX_BRIGHTNESS stays)
+#define RECT_CLAMP		5	// limit each led to the level of a color
+
+// merge modes (see mergeScreen())
+#define MERGE_OR		0	// or color bits of both screens
+#define MERGE_XOR		1	// xor color bits of both screens
+#define MERGE_MASK		2	// clear pixels that are black in the other screen
+
 // dot matrix display
 #define NUM_BLOCKS_X		2		// number of PixBlocks in horizontal direction
 #define NUM_BLOCKS_Y		1		// number of PixBlocks in vertical direction
 //#define ENABLE_HIDDEN_SCREEN		// if defined two screens (visible & hidden) are implemented
+//#define DM_PHASE_PLANES			// if defined the output of each brightness phase is precomputed
+									// (saves an estimated 13 cycles per PixBlock in the refresh interrupt,
+									// costs 6 bytes of RAM per pixel column, 12 with ENABLE_HIDDEN_SCREEN,
+									// i. e. 96 / 192 bytes for 2 PixBlocks)
+//#define DM_BCM					// if defined use binary code modulation instead of brightness phases
+//#define DM_PROFILING				// if defined latency and duration of the refresh interrupt are recorded
+//#define DM_VSCROLL				// if defined setVOffset() scrolls the screen vertically during refresh
+//#define DM_VIEWPORTS				// if defined each PixBlock can show its own region of the screen (see setViewport())
+//#define DM_DIMMING				// if defined setBrightness() dims the whole display
+#define DM_DIM_STEPS		16		// number of brightness steps (DM_DIM_STEPS = full brightness)
+#define DM_DIM_SLOT_MIN		DM_DIM_SLOT_AUTO	// shortest slot when dimming (timer ticks, must exceed the refresh interrupt)
+									// (DM_DIM_SLOT_AUTO = estimated refresh interrupt + 16 ticks, at least 64)
+//#define DM_MONO					// if defined the screen stores 1 bit per pixel shown in one color (see setMonoColor())
+//#define DM_PALETTE				// if defined pixels are palette indices resolved during refresh (see setPalette())
+//#define DM_COLUMN_RING			// if defined the main loop renders column frames in advance (see fillRing())
+#define DM_RING_SIZE		8		// number of column frames in the ring (power of 2, <= 128)
+//#define DM_SPRITES				// if defined sprites with save-under buffers are available (see showSprite())
+#define DM_SPRITE_WIDTH		8		// maximum width of a sprite (costs 2 pixel columns of RAM per column and sprite)
 
 #define COLS_PER_BLOCK		8		// number of columns per PixBlock (must be a power of 2)
 #define ROWS_PER_BLOCK		8		// number of rows per PixBlock
@@ -106,11 +157,86 @@ Disclaimer:			This software is provided by the copyright holder "as is" and any
 #define NUM_PIXCOLS			(NUM_BLOCKS   * COLS_PER_BLOCK)	// total number of pixel columns
 #define DIM_X				(NUM_BLOCKS_X * COLS_PER_BLOCK)	// number of pixels in x direction
 #define DIM_Y				(NUM_BLOCKS_Y * ROWS_PER_BLOCK)	// number of pixels in y direction
-#define MAX_BRIGHTNESS		3		// maximum brightness level of a pixel
+#define MAX_BRIGHTNESS		LEVEL_100	// maximum brightness level of a pixel
+
+// processor clock
+#ifndef F_CPU
+#define F_CPU				8000000UL	// 8 MHz
+#endif
+
+// refresh timing (timer1 is running at F_CPU / 8)
+#define DM_PRESCALER		2			// prescaler = 1:8 (do not change)
+#define DM_REFRESH_FREQ		2500		// dot matrix column refresh rate (Hz)
+										// If you change this value adapt function wait().
+#define DM_REFRESH			(uint16_t)(0.5 + F_CPU / (8.0 * DM_REFRESH_FREQ))
+// Binary code modulation shows each bit plane for one frame, the column time
+// doubling from one plane to the next (lsb first). On average there is still
+// one interrupt per DM_REFRESH timer ticks. The msb slot absorbs the rounding.
+#define DM_REFRESH_LSB		(uint16_t)(0.5 + DM_COLOR_DEPTH * F_CPU / (((1 << DM_COLOR_DEPTH) - 1) * 8.0 * DM_REFRESH_FREQ))
+#define DM_REFRESH_MSB		(DM_COLOR_DEPTH * DM_REFRESH - ((1 << (DM_COLOR_DEPTH - 1)) - 1) * DM_REFRESH_LSB)
+
+#define DM_ISR_HEADROOM		25			// percentage of the shortest slot left to the main program
+										// (see "ISR cycle budget" below)
+
+#ifdef DM_BCM
+#define DM_SLOT_MIN			DM_REFRESH_LSB	// shortest time between two refresh interrupts
+#define DM_FRAMES			DM_COLOR_DEPTH	// number of frames per brightness cycle
+#define DM_LAST_FRAME		(DM_COLOR_DEPTH - 1)
+#else
+#define DM_SLOT_MIN			DM_REFRESH
+#define DM_FRAMES			(MAX_BRIGHTNESS + 1)
+#define DM_LAST_FRAME		0
+#endif
+
+// profiling of the refresh interrupt (times in timer ticks = 1 us @ 8 MHz)
+#define DM_PROF_BINS		8		// number of histogram bins
+#define DM_PROF_BIN_SHIFT	6		// bin width = 2^DM_PROF_BIN_SHIFT timer ticks
+
+#if (DM_COLOR_DEPTH < 2) || (DM_COLOR_DEPTH > 4)
+#error "DM_COLOR_DEPTH must be 2, 3 or 4"
+#endif
+#if (DM_COLOR_DEPTH > 2) && !defined(DM_BCM)
+#error "DM_COLOR_DEPTH > 2 requires DM_BCM"
+#endif
+#ifdef DM_BCM
+#undef DM_PHASE_PLANES				// bit planes are shifted out directly
+#endif
+#ifdef DM_PALETTE
+#undef DM_PHASE_PLANES				// the palette is resolved while shifting out
+#endif
+#ifdef DM_MONO
+#undef DM_PHASE_PLANES				// the color is applied while shifting out
+#if defined(DM_BCM) || defined(DM_PALETTE) || defined(DM_SPRITES) || defined(DM_COLUMN_RING)
+#error "DM_MONO cannot be combined with DM_BCM, DM_PALETTE, DM_SPRITES or DM_COLUMN_RING"
+#endif
+#endif
+#if defined(DM_PALETTE) && defined(DM_COLUMN_RING)
+#error "DM_PALETTE cannot be combined with DM_COLUMN_RING"
+#endif
+#if defined(DM_COLUMN_RING) && !defined(DM_PHASE_PLANES) && !defined(DM_BCM)
+#error "DM_COLUMN_RING requires DM_PHASE_PLANES or DM_BCM"
+#endif
+#if defined(DM_SPRITES) && ((DIM_X > 127) || (DIM_Y > 127))
+#error "DM_SPRITES supports at most 127 pixels in each direction"
+#endif
 
 // display orientation
 //#define DM_LSB_FIRST				// shift out led bits with LSB first
 //#define DM_REVERSE_COLS			// reverse column order (from right to left)
+//#define DM_ROTATION				// if defined setOrientation() turns the display during refresh
+
+// orientations (see setOrientation())
+#define DM_ROT_0			0
+#define DM_ROT_90			1		// each PixBlock turned by 90 degrees clockwise (requires DM_PHASE_PLANES)
+#define DM_ROT_180			2		// whole display turned by 180 degrees
+#define DM_ROT_270			3		// = DM_ROT_90 + DM_ROT_180
+
+// pixel data conversion
+#define DM_SPREAD_LUT				// if defined pattern2PixCol() uses a 512 byte table in flash
+									// (comment out for flash-tight builds)
+
+// geometry
+#define DM_POLY_MAX			8		// maximum number of vertices of a polygon (see fillPolygon())
 
 // some character font defaults
 #define DEFAULT_FONT		font_diagonal_ccw
@@ -125,16 +251,110 @@ Disclaimer:			This software is provided by the copyright holder "as is" and any
 //#define EXTERNAL		3	// not implemented
 
 // hardware pins for accessing the dot matrix
+//#define DM_USE_USI				// shift out data with the USI in three-wire mode
+									// (DATA = DO/PA5, CLK = USCK/PA4, MSB first only)
+#ifdef DM_USE_USI
+#define DM_DATA_DDR			DDRA
+#define DM_DATA_PORT		PORTA
+#define DM_DATA_PIN			PINA
+#define DM_DATA_BIT			5		// DO   (do not change)
+#define DM_CLK_DDR			DDRA
+#define DM_CLK_PORT			PORTA
+#define DM_CLK_BIT			4		// USCK (do not change)
+#else
 #define DM_DATA_DDR			DDRB
 #define DM_DATA_PORT		PORTB
+#define DM_DATA_PIN			PINB	// writing a 1 toggles the data pin
 #define DM_DATA_BIT			0
 #define DM_CLK_DDR			DDRB
 #define DM_CLK_PORT			PORTB
 #define DM_CLK_BIT			1
+#endif
 #define DM_LATCH_DDR		DDRB
 #define DM_LATCH_PORT		PORTB
 #define DM_LATCH_BIT		2
 
+#if defined(DM_USE_USI) && defined(DM_LSB_FIRST)
+#error "DM_USE_USI supports MSB first only"
+#endif
+
+// ISR cycle budget
+// Cost model of the refresh interrupt in CPU cycles (avr-gcc -Os, worst case).
+// The cycle counts are estimates derived from the generated code, not
+// measurements, so the check below catches configurations that clearly do
+// not fit - it is no guarantee that a configuration passing it does.
+// The interrupt has to finish within the shortest slot (DM_SLOT_MIN) minus DM_ISR_HEADROOM.
+// Examples @ F_CPU = 8 MHz, DM_REFRESH_FREQ = 2500 Hz, DM_ISR_HEADROOM = 25:
+//
+//   slot / budget                  2 blocks    8 blocks    16 blocks
+//                                  bit-banged / USI (cycles)
+//   3200 / 2400 (phases)           492 / 228   1728 / 672  3376 / 1264
+//   3200 / 2400 (DM_PHASE_PLANES)  466 / 202   1624 / 568  3168 / 1056
+//   2136 / 1602 (DM_BCM, depth 2)  466 / 202   1624 / 568  3168 / 1056
+//   1368 / 1026 (DM_BCM, depth 3)  466 / 202   1624 / 568  3168 / 1056
+//    856 /  642 (DM_BCM, depth 4)  466 / 202   1624 / 568  3168 / 1056
+//
+// The phase rows do not depend on the color depth, but the phase engine only
+// supports DM_COLOR_DEPTH 2. Depth 3 and 4 always use the DM_BCM row of that
+// depth. The cycles per interrupt are the same for all depths, only the
+// shortest slot shrinks.
+
+#define DM_CYCLES_ISR		80		// prologue, timer, column & frame handling, latch, epilogue
+#if (NUM_PIXCOLS & (NUM_PIXCOLS - 1)) == 0
+#define DM_CYCLES_OFFSET	3		// add the screen offset and wrap (mask)
+#else
+#define DM_CYCLES_OFFSET	5		// add the screen offset and wrap (compare)
+#endif
+#ifdef DM_USE_USI
+#define DM_CYCLES_SHIFT		48		// shift out one column word (2 USI bytes)
+#else
+#define DM_CYCLES_SHIFT		180		// shift out one column word (16 bits bit-banged)
+#endif
+#if defined(DM_MONO)
+#define DM_CYCLES_FETCH		25		// index, load of the pixel byte, spread (lookup) and color
+#elif defined(DM_PALETTE)
+#define DM_CYCLES_FETCH		45		// index, load of the index word and palette lookup
+#elif defined(DM_PHASE_PLANES) || defined(DM_BCM)
+#define DM_CYCLES_FETCH		10		// index and load of the column word
+#else
+#define DM_CYCLES_FETCH		23		// index, load msb/lsb and combine for the current phase
+#endif
+#ifdef DM_VSCROLL
+#define DM_CYCLES_VSCROLL	80		// second load and rotate by up to 14 bits
+#else
+#define DM_CYCLES_VSCROLL	0
+#endif
+#ifdef DM_ROTATION
+#define DM_CYCLES_ROTATE	16		// reverse the rows of the column word (lookup)
+#else
+#define DM_CYCLES_ROTATE	0
+#endif
+#ifdef DM_PROFILING
+#define DM_CYCLES_PROF		120		// DotMatrix::profile()
+#else
+#define DM_CYCLES_PROF		0
+#endif
+
+#define DM_ISR_CYCLES		(DM_CYCLES_ISR + DM_CYCLES_PROF + (uint32_t)NUM_BLOCKS * (DM_CYCLES_OFFSET + DM_CYCLES_FETCH + DM_CYCLES_VSCROLL + DM_CYCLES_ROTATE + DM_CYCLES_SHIFT))
+#define DM_ISR_BUDGET		((uint32_t)DM_SLOT_MIN * 8 * (100 - DM_ISR_HEADROOM) / 100)	// timer1 tick = 8 cycles
+#define DM_DIM_SLOT_AUTO	((DM_ISR_CYCLES / 8 + 16 > 64) ? (DM_ISR_CYCLES / 8 + 16) : 64)
+
+#if __cplusplus >= 201103L
+static_assert(DM_ISR_CYCLES <= DM_ISR_BUDGET,
+	"refresh interrupt does not fit into DM_SLOT_MIN - reduce NUM_BLOCKS_X/NUM_BLOCKS_Y "
+	"or DM_REFRESH_FREQ, define DM_USE_USI or lower DM_ISR_HEADROOM");
+#ifdef DM_DIMMING
+static_assert(DM_ISR_CYCLES < (uint32_t)DM_DIM_SLOT_MIN * 8,
+	"refresh interrupt does not fit into DM_DIM_SLOT_MIN - increase DM_DIM_SLOT_MIN");
+#endif
+#else
+// C++98: an error about a negative array size here means the same as the messages above
+typedef char dm_check_isr_fits_slot_min[(DM_ISR_CYCLES <= DM_ISR_BUDGET) ? 1 : -1];
+#ifdef DM_DIMMING
+typedef char dm_check_isr_fits_dim_slot_min[(DM_ISR_CYCLES < (uint32_t)DM_DIM_SLOT_MIN * 8) ? 1 : -1];
+#endif
+#endif
+
 
 /**************
  * data types *
@@ -142,10 +362,73 @@ Disclaimer:			This software is provided by the copyright holder "as is" and any
 
 typedef struct {
 	uint16_t lsb;
+#if DM_COLOR_DEPTH > 2
+	uint16_t mid[DM_COLOR_DEPTH - 2];	// intermediate bit planes (ascending significance)
+#endif
 	uint16_t msb;
 } pixcol_t;
 
 
+#ifdef DM_MONO
+typedef uint8_t scrcol_t;			// screen column: 1 bit per pixel (bit 0 = top pixel)
+#else
+typedef pixcol_t scrcol_t;			// screen column
+#endif
+
+
+typedef struct {
+#ifdef DM_VSCROLL
+	uint8_t   idx[NUM_PIXCOLS * 2];	// pixel column shifted out for each column and PixBlock
+									// (followed by the column of the block row below)
+	uint8_t   vshift[NUM_BLOCKS];	// bits to rotate the column word of each PixBlock (shift order)
+#else
+	uint8_t   idx[NUM_PIXCOLS];		// pixel column shifted out for each column and PixBlock
+#endif
+#ifdef DM_ROTATION
+	uint8_t   rev;					// 1 if the rows of each column word are reversed
+#endif
+} dm_colmap_t;
+
+#if defined(DM_VSCROLL) || defined(DM_VIEWPORTS) || defined(DM_ROTATION)
+#define DM_COLMAPS			2		// column map is rebuilt at runtime (in the spare map)
+#else
+#define DM_COLMAPS			1		// column map is built once by init()
+#endif
+
+
+typedef struct {
+	uint8_t   slot;					// number of the interrupt the frame is rendered for
+	uint8_t   epoch;				// ring epoch (incremented by update() when the ring ran dry)
+	scrcol_t* scr;					// screen the frame is rendered from
+	uint16_t  word[NUM_BLOCKS];		// column data in shift order (last PixBlock first)
+} dm_ringframe_t;
+
+
+typedef struct {
+	uint32_t samples;				// number of recorded interrupts
+	uint32_t dur_sum;				// sum of all durations (average = dur_sum / samples)
+	uint16_t dur_min;				// duration from entry to exit of the interrupt
+	uint16_t dur_max;
+	uint16_t lat_min;				// latency from compare match to entry (incl. prologue)
+	uint16_t lat_max;
+	uint16_t missed;				// number of interrupts that ended after the next compare match
+	uint16_t hist[DM_PROF_BINS];	// histogram of durations
+} dm_profile_t;
+
+
+// A sprite is stored in flash as an array of uint16_t:
+// width (1..DM_SPRITE_WIDTH), then for each column (left to right)
+// the mask and DM_COLOR_DEPTH bit planes (lsb first) of a pixel column.
+// The mask has both led bits of each pixel set that belongs to the sprite.
+typedef struct {
+	const uint16_t* data;			// sprite in flash
+	int8_t    x;					// position of upper left corner (may be off-screen)
+	int8_t    y;
+	uint8_t   shown;				// 1 while the sprite is drawn (buffer under[] is valid)
+	pixcol_t  under[DM_SPRITE_WIDTH * 2];	// covered pixel columns (upper and lower PixBlock row)
+} dm_sprite_t;
+
+
 /********
  * data *
  ********/
@@ -165,34 +448,217 @@ class DotMatrix
 public:
 	static void init();
 	static void clearScreen();
+	static void copyScreen(const uint8_t vis_hid);
+	static void mergeScreen(const uint8_t vis_hid, const uint8_t mode);
+	static uint8_t fadeStep(const uint8_t vis_hid);
 	static void selectScreen(uint8_t vis_hid);
 	static void swapScreen();
+	static void waitForVsync();
+	static uint8_t swapPending() { return (swap_req); }		// 1 until a requested swap has been carried out
+	static uint8_t getFrameCounter() { return (frame_cnt); }	// incremented at the start of each frame
 	static void setOffset(const uint8_t col);
+	static uint8_t getOffset() { return (offset); }
+#ifdef DM_VSCROLL
+	static void setVOffset(const uint8_t row);
+#endif
+#ifdef DM_VIEWPORTS
+	static void setViewport(const uint8_t block, const uint8_t x, const uint8_t y);
+#endif
+#ifdef DM_ROTATION
+	static void setOrientation(uint8_t orientation);
+#endif
+#ifdef DM_DIMMING
+	static void setBrightness(uint8_t level);
+#endif
+#ifdef DM_MONO
+	static void setMonoColor(const uint8_t color);
+	static uint8_t getMonoColor() { return (mono_color); }
+#endif
+#ifdef DM_PALETTE
+	static void setPalette(const uint8_t index, const uint8_t color);
+	static uint8_t getPalette(const uint8_t index) { return (pal[index & 3]); }
+#endif
 	static uint8_t displayText(const uint8_t x, const uint8_t y, const uint8_t mode, const char* st, const uint8_t src_mem_type, const uint16_t text_column, const uint8_t len);
 	static void displayGraphics(const uint8_t x, const uint8_t y, const uint8_t mode, const uint16_t* graphics, const uint8_t src_mem_type,  const uint8_t len);
+	static uint8_t expandColor(const uint8_t code);
 	static void pattern2PixCol(const uint8_t pix_data, const uint8_t color, pixcol_t* pc);
 	static void setPixCol(const uint8_t x, const uint8_t y, const pixcol_t* pc, const uint8_t mode);
 	static void setPixel(uint8_t x, uint8_t y, const uint8_t color);
 	static uint8_t getPixel(uint8_t x, uint8_t y, const uint8_t vis_hid);
+	static uint8_t readRegion(const uint8_t x, const uint8_t y, const uint8_t w, const uint8_t h, const uint8_t vis_hid, uint8_t* occ, uint8_t* red, uint8_t* green);
+	static uint8_t getRow(const uint8_t x, const uint8_t y, const uint8_t color_bit, const uint8_t vis_hid);
+	static void setRow(const uint8_t x, const uint8_t y, const uint8_t color_bit, const uint8_t data);
+	static void getRows(const uint8_t x, const uint8_t y, const uint8_t color_bit, uint8_t* rows, const uint8_t vis_hid);
+	static void setRows(const uint8_t x, const uint8_t y, const uint8_t color_bit, const uint8_t* rows);
+	static void transpose8(uint8_t* m);
+	static void fillRect(const uint8_t x, const uint8_t y, const uint8_t w, const uint8_t h, const uint8_t color) { rect(x, y, w, h, color, OPAQUE); }
+	static void clearRect(const uint8_t x, const uint8_t y, const uint8_t w, const uint8_t h) { rect(x, y, w, h, BLACK, OPAQUE); }
+	static void invertRect(const uint8_t x, const uint8_t y, const uint8_t w, const uint8_t h) { rect(x, y, w, h, 0xFF, XOR); }
+	static void drawLine(int16_t x0, int16_t y0, const int16_t x1, const int16_t y1, const uint8_t color);
+	static void drawCircle(const int16_t xc, const int16_t yc, const int16_t r, const uint8_t color);
+	static void fillPolygon(const int16_t* xy, const uint8_t n, const uint8_t color);
+	static void dimRect(const uint8_t x, const uint8_t y, const uint8_t w, const uint8_t h) { rect(x, y, w, h, 0, RECT_DIM); }
+	static void brightenRect(const uint8_t x, const uint8_t y, const uint8_t w, const uint8_t h) { rect(x, y, w, h, 0, RECT_BRIGHTEN); }
+	static void clampRect(const uint8_t x, const uint8_t y, const uint8_t w, const uint8_t h, const uint8_t color) { rect(x, y, w, h, color, RECT_CLAMP); }
 	static void displayLogo();
 	static void update();
+#ifdef DM_COLUMN_RING
+	static void fillRing();
+	static uint16_t getRingUnderruns();
+	static uint16_t getRingDropped();
+#endif
+#ifdef DM_SPRITES
+	static void showSprite(dm_sprite_t* s, const uint16_t* data, const int8_t x, const int8_t y);
+	static void hideSprite(dm_sprite_t* s);
+#endif
+#ifdef DM_PROFILING
+	static void profile(const uint16_t t_due, const uint16_t t_entry);
+	static void getProfile(dm_profile_t* p);
+	static void clearProfile();
+	static void showProfile(const uint8_t x, const uint8_t y);
+#endif
+	static uint16_t slotLength()
+	// Return the number of timer ticks until the next call of update().
+	// Has to be called right before update().
+	{
+#if defined(DM_DIMMING)
+		return (slot_len[bright_cnt]);
+#elif defined(DM_BCM)
+		if (bright_cnt == DM_COLOR_DEPTH - 1) { return (DM_REFRESH_MSB); }
+		return (DM_REFRESH_LSB << bright_cnt);
+#else
+		return (DM_REFRESH);
+#endif
+	}
 
 private:
 	static uint8_t offset;			// screen offset
+#ifdef DM_VSCROLL
+	static uint8_t voffset;			// vertical screen offset
+#endif
+	static dm_colmap_t colmap[DM_COLMAPS];	// column tables: one in use, the other one is rebuilt
+	static dm_colmap_t* cmap;		// column table used by the refresh
+#ifdef DM_VIEWPORTS
+	static uint8_t vp_x[NUM_BLOCKS];	// screen position shown by each PixBlock
+	static uint8_t vp_y[NUM_BLOCKS];
+#endif
+#ifdef DM_ROTATION
+	static uint8_t orient;			// display orientation
+#endif
 #ifdef ENABLE_HIDDEN_SCREEN
-	static pixcol_t screen[NUM_BLOCKS * COLS_PER_BLOCK * 2];
+	static scrcol_t screen[NUM_BLOCKS * COLS_PER_BLOCK * 2];
 #else
-	static pixcol_t screen[NUM_BLOCKS * COLS_PER_BLOCK];
+	static scrcol_t screen[NUM_BLOCKS * COLS_PER_BLOCK];
+#endif
+#ifdef DM_PHASE_PLANES
+#ifdef ENABLE_HIDDEN_SCREEN
+	static uint16_t plane[3][NUM_BLOCKS * COLS_PER_BLOCK * 2];
+#else
+	static uint16_t plane[3][NUM_BLOCKS * COLS_PER_BLOCK];
+#endif
 #endif
-	static pixcol_t* scr_vis;		// visible screen
-	static pixcol_t* scr_hid;		// hidden screen
-	static pixcol_t* scr_wrk;		// working screen
+	static scrcol_t* scr_vis;		// visible screen
+	static scrcol_t* scr_hid;		// hidden screen
+	static scrcol_t* scr_wrk;		// working screen
+	static scrcol_t* scr_out;		// screen which is being shifted out
+	static volatile uint8_t swap_req;	// swap of screens requested
+	static volatile uint8_t frame_cnt;	// frame counter
 	static uint8_t column;			// current column number (0..7)
-	static uint8_t bright_cnt;		// brightness counter
+	static uint8_t bright_cnt;		// brightness counter (with DM_BCM: current bit plane)
+#ifdef DM_DIMMING
+	static uint8_t dim_on;			// 1 if a dark frame is appended to each brightness cycle
+	static uint16_t slot_len[DM_FRAMES + 1];	// slot of each frame (last one: dark frame)
+#endif
+#ifdef DM_MONO
+	static uint8_t mono_color;		// color of all pixels
+	static uint16_t mono_out[DM_FRAMES];	// output of mono_color in each frame
+#endif
+#ifdef DM_PALETTE
+	static uint8_t pal[4];			// palette colors
+	static uint16_t pal_out[DM_FRAMES][4];	// output of the palette entries in each frame (see setPalette())
+#endif
 	static uint8_t color;			// current text color
+#ifdef DM_PROFILING
+	static dm_profile_t prof;		// refresh interrupt statistics
+#endif
+#ifdef DM_COLUMN_RING
+	static dm_ringframe_t ring[DM_RING_SIZE];	// column frames rendered in advance
+	static volatile uint8_t ring_head;	// written by fillRing() only
+	static volatile uint8_t ring_tail;	// written by update() only
+	static volatile uint8_t ring_slot;	// number of the next interrupt
+	static volatile uint8_t ring_epoch;	// incremented on each underrun
+	static uint16_t ring_underruns;	// interrupts without a matching frame
+	static uint16_t ring_dropped;	// outdated frames skipped by update()
+	static uint8_t rp_slot;			// state of the producer (fillRing())
+	static uint8_t rp_epoch;
+	static uint8_t rp_column;
+	static uint8_t rp_bright;
+	static scrcol_t* rp_scr;
+#endif
 
 	static void shift_out(uint16_t data);
+	static const uint16_t* outputPlane(const scrcol_t* scr, const uint8_t bc);
+	static uint16_t column_word(const uint16_t* pl, const uint8_t c);
+	static uint16_t block_word(const uint16_t* pl, const uint8_t* ci, const uint8_t b);
+	template <uint8_t N> static void shift_blocks(const uint16_t* pl, const uint8_t* ci);
+	template <uint8_t N> static void shift_words(const uint16_t* w);
+#ifdef DM_COLUMN_RING
+	static const dm_ringframe_t* popRing();
+#endif
+	static void calcColIdx();
+	static uint8_t nextFrame(uint8_t bc);
+	static uint16_t frameWord(const pixcol_t* pc, const uint8_t f);
+	static void render(const uint8_t idx);
+#if defined(DM_ROTATION) && defined(DM_PHASE_PLANES)
+	static void renderRot90(const scrcol_t* scr, const uint8_t first);
+#endif
+#ifdef DM_SPRITES
+	static void drawSprite(dm_sprite_t* s, const uint8_t restore);
+#endif
+	static void span(const int16_t x, int16_t y0, int16_t y1, const uint8_t color);
+	static void rect(const uint8_t x, const uint8_t y, const uint8_t w, const uint8_t h, uint8_t color, const uint8_t mode);
 	static uint8_t readChar(const char* ptr, const uint8_t src_mem_type);
+
+	friend class Ticker;
+};
+
+
+/*****************
+ * ticker class  *
+ *****************/
+
+// A Ticker scrolls a text through the display with setOffset(). Each step()
+// renders only the pixel column that enters at the right edge, so the cost
+// of a step does not depend on the text length or the display width.
+// The text format is the same as with displayText(). Since setOffset()
+// scrolls the whole screen, the other block rows move along.
+// With more than one block row (NUM_BLOCKS_Y > 1) the text row y need not
+// be a multiple of 8: a text row across two block rows is written in two
+// parts, each to the screen column that enters its block row. Text rows
+// below the last block row are clipped.
+
+class Ticker
+{
+public:
+	void start(const char* st, const uint8_t src_mem_type, const uint8_t y, const uint8_t mode);
+	uint8_t step();
+
+private:
+	void rewind();
+	void putPart(const uint16_t c, const uint8_t r, const uint8_t h, const uint8_t pattern);
+
+	const char*	text;			// start of ticker text
+	const char*	ptr;			// next character of ticker text
+	uint8_t		mem_type;		// memory type of ticker text (RAM, FLASH, ...)
+	uint8_t		row;			// pixel row of the text
+	uint8_t		mode;			// display mode (OPAQUE, TRANSPARENT, XOR)
+	uint8_t		w;				// remaining columns of the current character
+	uint8_t		invert;			// inversion flag
+	uint8_t		color;			// current text color
+	uint8_t		char_base;		// character code of first character in font
+	uint8_t		num_of_chars;	// number of characters in current font
+	const unsigned char* const*	font;	// current font
+	const unsigned char*		p;		// pixel data of the current character
 };
 
 
@@ -0,0 +1,72 @@
+/*
+ * bitstream.cpp
+ *
+ */
+
+/**********************************************************************************
+
+Description:		Drive DotMatrix through a fixed sequence of drawing calls and
+					refresh interrupts and print the latched bitstream (see
+					regmodel.cpp). Built once with and once without DM_USE_USI,
+					both streams have to be identical (see Makefile).
+
+License:			see "license.md"
+
+**********************************************************************************/
+
+#include <stdio.h>
+#include <avr/pgmspace.h>
+
+#include "dot_matrix.h"
+#include "regmodel.h"
+
+
+static const char text[] = "\x01\x1C" "Hi \x10" "42\x13" "ab";
+static uint32_t seed = 1;
+
+
+static uint16_t random16()
+// fixed generator, so the sequence does not depend on the C library
+{
+	seed = seed * 1103515245UL + 12345;
+	return ((seed >> 16) & 0x7FFF);
+}
+
+
+static void refresh(uint8_t n)
+{
+	while (n--) { DotMatrix::update(); }
+}
+
+
+int main()
+{
+	uint8_t		f, i;
+	pixcol_t	pc;
+
+	DotMatrix::init();
+	for (f = 0; f < 60; f++) {
+		switch (random16() % 5) {
+		case 0:
+			for (i = 0; i < 20; i++) { DotMatrix::setPixel(random16() % DIM_X, random16() % DIM_Y, random16() & 0xFF); }
+			break;
+		case 1:
+			DotMatrix::pattern2PixCol(random16(), random16() & 0xFF, &pc);
+			DotMatrix::setPixCol(random16() % DIM_X, random16() % DIM_Y, &pc, random16() % 3);
+			break;
+		case 2:
+			DotMatrix::displayText(random16() % DIM_X, random16() % DIM_Y, random16() % 3, text, RAM, random16() % 8, random16() % 20);
+			break;
+		case 3:
+			DotMatrix::setOffset(random16() % NUM_PIXCOLS);
+			break;
+		case 4:
+			if ((random16() & 3) == 0) { DotMatrix::clearScreen(); }
+			break;
+		}
+		if (f == 30) { DotMatrix::displayLogo(); }
+		refresh(4 * COLS_PER_BLOCK);
+	}
+	regmodel_print(stdout);
+	return (0);
+}
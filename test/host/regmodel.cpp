@@ -0,0 +1,116 @@
+/*
+ * regmodel.cpp
+ *
+ */
+
+/**********************************************************************************
+
+Description:		Host-side register model of the PixBlock interface
+
+					Follows the data, clock and latch lines written by
+					DotMatrix::shift_out() and update(), either bit-banged on
+					PORTB/PINB or through the USI (USIDR/USICR, DO = PA5,
+					USCK = PA4). At every rising clock edge the data line is
+					shifted into a 16 bit word, at every rising edge of the
+					latch line the words shifted since the last latch are
+					recorded together with the clock level (column sync).
+
+License:			see "license.md"
+
+**********************************************************************************/
+
+#include <stdio.h>
+#include <vector>
+#include <avr/io.h>
+
+#include "regmodel.h"
+
+
+Reg PORTA = {0, REG_PORTA}, DDRA = {0, REG_DDRA}, PINA = {0, REG_PINA};
+Reg PORTB = {0, REG_PORTB}, DDRB = {0, REG_DDRB}, PINB = {0, REG_PINB};
+Reg USICR = {0, REG_USICR}, USISR = {0, REG_USISR}, USIDR = {0, REG_USIDR};
+Reg TIMSK1 = {0, REG_OTHER}, TIFR1 = {0, REG_OTHER};
+volatile uint16_t OCR1A, OCR1B, TCNT1;
+
+static std::vector<uint16_t>	words;		// words shifted since the last latch
+static uint16_t					word;		// word being shifted in
+static uint8_t					nbits;		// bits of word
+static std::vector<latch_t>		latches;	// recorded latch events
+
+
+static uint8_t clock_line()
+{
+#ifdef DM_USE_USI
+	return ((PORTA.v >> 4) & 1);			// USCK = PA4 (toggled by USITC)
+#else
+	return ((PORTB.v >> 1) & 1);
+#endif
+}
+
+
+static uint8_t data_line()
+{
+#ifdef DM_USE_USI
+	if (USICR.v & (1 << USIWM0)) { return (USIDR.v >> 7); }	// three-wire mode: DO = USIDR bit 7
+	return ((PORTA.v >> 5) & 1);
+#else
+	return (PORTB.v & 1);
+#endif
+}
+
+
+void Reg::set(uint8_t n)
+{
+	uint8_t	clk = clock_line();
+	uint8_t	old = v;
+
+	switch (id) {
+	case REG_PINA:							// writing a 1 toggles the port bit
+		PORTA.set(PORTA.v ^ n);
+		return;
+	case REG_PINB:
+		PORTB.set(PORTB.v ^ n);
+		return;
+	case REG_USICR:							// strobe bits are not stored
+		v = n & ~((1 << USICLK) | (1 << USITC));
+		if (n & (1 << USITC)) { PORTA.set(PORTA.v ^ (1 << 4)); }
+		if ((n & (1 << USICLK)) && !(n & ((1 << USICS1) | (1 << USICS0)))) { USIDR.v <<= 1; }
+		return;
+	}
+	v = n;
+	if (clock_line() && !clk) {				// rising clock edge
+		word = (word << 1) | data_line();
+		if (++nbits == 16) {
+			words.push_back(word);
+			nbits = 0;
+		}
+	}
+	if ((id == REG_PORTB) && (n & 4) && !(old & 4)) {	// rising edge of the latch (PB2)
+		latch_t	l;
+		l.clock = clock_line();
+		l.bits  = nbits;
+		l.words = words;
+		latches.push_back(l);
+		words.clear();
+		nbits = 0;
+	}
+}
+
+
+const std::vector<latch_t>& regmodel_latches()
+{
+	return (latches);
+}
+
+
+void regmodel_print(FILE* f)
+// one line per latch: clock level, left-over bits and the latched words
+{
+	for (size_t i = 0; i < latches.size(); i++) {
+		fprintf(f, "clk %u bits %u:", latches[i].clock, latches[i].bits);
+		for (size_t k = 0; k < latches[i].words.size(); k++) {
+			fprintf(f, " %04x", latches[i].words[k]);
+		}
+		fprintf(f, "\n");
+	}
+}
@@ -0,0 +1,22 @@
+/*
+ * regmodel.h
+ *
+ */
+
+#ifndef REGMODEL_H_
+#define REGMODEL_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <vector>
+
+typedef struct {
+	uint8_t		clock;				// clock level at the latch (low after column 0)
+	uint8_t		bits;				// bits shifted after the last complete word (should be 0)
+	std::vector<uint16_t> words;	// words shifted since the previous latch (first = last PixBlock)
+} latch_t;
+
+const std::vector<latch_t>& regmodel_latches();
+void regmodel_print(FILE* f);
+
+#endif /* REGMODEL_H_ */
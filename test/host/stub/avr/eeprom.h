@@ -0,0 +1,14 @@
+/*
+ * avr/eeprom.h (host stub): eeprom is ordinary memory
+ */
+
+#ifndef HOST_AVR_EEPROM_H_
+#define HOST_AVR_EEPROM_H_
+
+#include <stdint.h>
+
+#define EEMEM
+static inline uint8_t  eeprom_read_byte(const uint8_t* p)  { return (*p); }
+static inline uint16_t eeprom_read_word(const uint16_t* p) { return (*p); }
+
+#endif /* HOST_AVR_EEPROM_H_ */
@@ -0,0 +1,53 @@
+/*
+ * avr/io.h (host stub)
+ *
+ * Register model of the ATtiny84A i/o registers used by dot_matrix.cpp.
+ * Every write is passed to Reg::set() (see regmodel.cpp), which follows
+ * the data, clock and latch lines of the PixBlock chain.
+ */
+
+#ifndef HOST_AVR_IO_H_
+#define HOST_AVR_IO_H_
+
+#include <stdint.h>
+
+struct Reg {
+	uint8_t	v;
+	uint8_t	id;
+	void set(uint8_t n);
+	operator uint8_t() const { return (v); }
+	Reg& operator=(int n)  { set(n);     return (*this); }
+	Reg& operator|=(int n) { set(v | n); return (*this); }
+	Reg& operator&=(int n) { set(v & n); return (*this); }
+	Reg& operator^=(int n) { set(v ^ n); return (*this); }
+};
+
+// register ids (see regmodel.cpp)
+#define REG_PORTA		1
+#define REG_DDRA		2
+#define REG_PINA		3
+#define REG_PORTB		4
+#define REG_DDRB		5
+#define REG_PINB		6
+#define REG_USICR		7
+#define REG_USISR		8
+#define REG_USIDR		9
+#define REG_OTHER		10
+
+extern Reg PORTA, DDRA, PINA, PORTB, DDRB, PINB, USICR, USISR, USIDR, TIMSK1, TIFR1;
+extern volatile uint16_t OCR1A, OCR1B, TCNT1;
+
+#define PA4		4
+#define PA5		5
+
+#define USIWM1	5
+#define USIWM0	4
+#define USICS1	3
+#define USICS0	2
+#define USICLK	1
+#define USITC	0
+
+#define OCIE1A	1
+#define OCIE1B	2
+
+#endif /* HOST_AVR_IO_H_ */
@@ -0,0 +1,14 @@
+/*
+ * avr/pgmspace.h (host stub): flash is ordinary memory
+ */
+
+#ifndef HOST_AVR_PGMSPACE_H_
+#define HOST_AVR_PGMSPACE_H_
+
+#include <stdint.h>
+
+#define PROGMEM
+#define pgm_read_byte(p)	(*(const uint8_t*)(p))
+#define pgm_read_word(p)	(*(p))
+
+#endif /* HOST_AVR_PGMSPACE_H_ */
@@ -0,0 +1,12 @@
+/*
+ * util/atomic.h (host stub): there are no interrupts on the host
+ */
+
+#ifndef HOST_UTIL_ATOMIC_H_
+#define HOST_UTIL_ATOMIC_H_
+
+#define ATOMIC_FORCEON			0
+#define ATOMIC_RESTORESTATE		0
+#define ATOMIC_BLOCK(type)		for (int _atomic = 1; _atomic; _atomic = 0)
+
+#endif /* HOST_UTIL_ATOMIC_H_ */
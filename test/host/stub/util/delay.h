@@ -0,0 +1,10 @@
+/*
+ * util/delay.h (host stub): delays take no time
+ */
+
+#ifndef HOST_UTIL_DELAY_H_
+#define HOST_UTIL_DELAY_H_
+
+static inline void _delay_us(double us) { (void)us; }
+
+#endif /* HOST_UTIL_DELAY_H_ */